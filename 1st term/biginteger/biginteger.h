@@ -1,16 +1,95 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <cmath>
 #include <compare>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <initializer_list>
 #include <iostream>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-const int kRationalToDoublePrecision = 20;
-const int kBase = 1e9;
-const int kBaseLength = 9;
+#if !defined(BIGINTEGER_NO_SIMD) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BIGINTEGER_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+const size_t kRationalToDoubleLimbs = 4;
+const int kDecimalBase = 1e9;
+const int kDecimalBaseLength = 9;
+const int kBinaryFormatVersion = 1;
+
+// A limb never needs more than kBaseBits bits. With BIGINTEGER_BINARY_RADIX
+// limbs hold exactly that many bits, so carries are shifts and masks, and
+// decimal conversion only happens in toString and parsing.
+const int kBaseBits = 30;
+#ifdef BIGINTEGER_BINARY_RADIX
+const int kBase = 1 << kBaseBits;
+#else
+const int kBase = kDecimalBase;
+#endif
+
+#ifndef BIGINTEGER_INLINE_LIMBS
+#define BIGINTEGER_INLINE_LIMBS 4
+#endif
+
+#ifndef BIGINTEGER_KARATSUBA_THRESHOLD
+#define BIGINTEGER_KARATSUBA_THRESHOLD 40
+#endif
+
+#ifndef BIGINTEGER_TOOM3_THRESHOLD
+#define BIGINTEGER_TOOM3_THRESHOLD 400
+#endif
+
+#ifndef BIGINTEGER_NTT_THRESHOLD
+#define BIGINTEGER_NTT_THRESHOLD 800
+#endif
+
+#ifndef BIGINTEGER_RADIX_CONVERSION_THRESHOLD
+#define BIGINTEGER_RADIX_CONVERSION_THRESHOLD 40
+#endif
+
+#ifndef BIGINTEGER_RATIONAL_NORMALIZE_THRESHOLD
+#define BIGINTEGER_RATIONAL_NORMALIZE_THRESHOLD 0
+#endif
+
+#ifndef BIGINTEGER_BURNIKEL_ZIEGLER_THRESHOLD
+#define BIGINTEGER_BURNIKEL_ZIEGLER_THRESHOLD 60
+#endif
+
+#ifndef BIGINTEGER_PARALLEL_THRESHOLD
+#define BIGINTEGER_PARALLEL_THRESHOLD 20000
+#endif
+
+const size_t kInlineLimbs = BIGINTEGER_INLINE_LIMBS;
+const size_t kKaratsubaThreshold = BIGINTEGER_KARATSUBA_THRESHOLD;
+const size_t kToom3Threshold = BIGINTEGER_TOOM3_THRESHOLD;
+const size_t kNttThreshold = BIGINTEGER_NTT_THRESHOLD;
+const size_t kNttMaxSize = 1 << 24;
+const size_t kBurnikelZieglerThreshold = BIGINTEGER_BURNIKEL_ZIEGLER_THRESHOLD;
+const size_t kRadixConversionThreshold = BIGINTEGER_RADIX_CONVERSION_THRESHOLD;
+const size_t kRationalNormalizeThreshold = BIGINTEGER_RATIONAL_NORMALIZE_THRESHOLD;
+const size_t kParallelThreshold = BIGINTEGER_PARALLEL_THRESHOLD;
 
 enum Sign { positive, negative };
 
+// Low nibble of the tag byte that starts every binary encoded BigInteger.
+enum BinaryLayout { small_layout, decimal_limbs_layout, binary_limbs_layout };
+
 Sign operator! (const Sign& sign) {
   return sign == positive ? negative : positive;
 }
@@ -20,470 +99,3799 @@ Sign operator* (const Sign& first, const Sign& second) {
          (first == positive || second == positive) ? negative : positive;
 }
 
-class BigInteger {
+// Scoped arena for limb buffers, after StackStorage: memory is carved from
+// large blocks and only returned to the system when the arena is destroyed.
+// While one is alive, every limb buffer its thread allocates comes from it,
+// freed buffers are kept in power-of-two size classes for reuse, and the
+// worker threads of RunTasks share it. Arenas nest.
+//
+// Whatever allocates inside the scope has to be destroyed inside it, which
+// includes values declared outside that grow while it is active; results
+// are taken out with Export, which copies onto the heap. Unless NDEBUG is
+// defined, the destructor checks that no buffer is still in use.
+class BigIntegerArena {
  private:
-  std::vector<long long> digits_;
-  Sign sign_ = positive;
+  struct Block {
+    char* begin;
+    size_t size;
+  };
 
-  void NormalizeDigits() {
-    while (!digits_.empty() && digits_.back() == 0) {
-      digits_.pop_back();
+  std::vector<Block> blocks_;
+  char* current_ = nullptr;
+  char* end_ = nullptr;
+  size_t next_block_size_;
+  std::array<void*, 64> free_lists_{};
+  size_t live_buffers_ = 0;
+  BigIntegerArena* previous_;
+  std::mutex mutex_;
+
+  static BigIntegerArena*& Active() {
+    thread_local BigIntegerArena* active = nullptr;
+    return active;
+  }
+
+  static bool& Suspended() {
+    thread_local bool suspended = false;
+    return suspended;
+  }
+
+  // Number of RunTasks calls whose workers use an arena; the mutex is only
+  // taken while it is nonzero.
+  static std::atomic<size_t>& SharingCount() {
+    static std::atomic<size_t> count{0};
+    return count;
+  }
+
+  static size_t SizeClass(size_t bytes) {
+    return std::bit_width(std::max<size_t>(bytes, sizeof(void*)) - 1);
+  }
+
+  bool Owns(const void* pointer) const {
+    for (const Block& block : blocks_) {
+      if (block.begin <= pointer && pointer < block.begin + block.size) {
+        return true;
+      }
     }
+    return false;
+  }
 
-    if (digits_.empty()) {
-      digits_.push_back(0);
-      sign_ = positive;
+  void* Allocate(size_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (SharingCount() != 0) {
+      lock.lock();
+    }
+    ++live_buffers_;
+    size_t size_class = SizeClass(bytes);
+    if (free_lists_[size_class] != nullptr) {
+      void* pointer = free_lists_[size_class];
+      free_lists_[size_class] = *static_cast<void**>(pointer);
+      return pointer;
     }
+
+    size_t size = size_t(1) << size_class;
+    if ((size_t)(end_ - current_) < size) {
+      size_t block_size = std::max(next_block_size_, size);
+      blocks_.push_back({static_cast<char*>(::operator new(block_size)), block_size});
+      current_ = blocks_.back().begin;
+      end_ = current_ + block_size;
+      next_block_size_ = 2 * block_size;
+    }
+    current_ += size;
+    return current_ - size;
   }
 
-  void BuildFromUll(unsigned long long num) {
-    while (num) {
-      digits_.push_back(std::abs((int)(num % kBase)));
-      num /= kBase;
+  // Takes the buffer back if it came from this arena. The ownership check
+  // reads blocks_, which another worker may be growing, so it is done under
+  // the same lock as the release.
+  bool Deallocate(void* pointer, size_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (SharingCount() != 0) {
+      lock.lock();
+    }
+    if (!Owns(pointer)) {
+      return false;
     }
+    --live_buffers_;
+    size_t size_class = SizeClass(bytes);
+    *static_cast<void**>(pointer) = free_lists_[size_class];
+    free_lists_[size_class] = pointer;
+    return true;
   }
 
-  BigInteger(std::vector<long long> digits, Sign sign) : digits_(digits), sign_(sign) {}
+  template <typename T>
+  friend class ArenaAllocator;
+  friend void RunTasks(const std::vector<std::function<void()>>& tasks);
 
  public:
-  BigInteger operator- () const {
-    if (digits_.size() > 1 || digits_[0] != 0) {
-      return BigInteger{digits_, !sign_};
+  explicit BigIntegerArena(size_t initial_size = 1 << 16)
+      : next_block_size_(initial_size), previous_(Active()) {
+    Active() = this;
+  }
+
+  BigIntegerArena(const BigIntegerArena&) = delete;
+  BigIntegerArena& operator=(const BigIntegerArena&) = delete;
+
+  // A buffer still in use here belongs to a value that outlives the scope,
+  // typically one declared before the arena that grew inside it.
+  ~BigIntegerArena() {
+    assert(live_buffers_ == 0 && "BigIntegerArena: a value allocated in the arena outlives it");
+    Active() = previous_;
+    for (Block& block : blocks_) {
+      ::operator delete(block.begin);
     }
+  }
 
-    return BigInteger{digits_, positive};
+  size_t ReservedBytes() const {
+    size_t bytes = 0;
+    for (const Block& block : blocks_) {
+      bytes += block.size;
+    }
+    return bytes;
   }
 
-  BigInteger& operator+= (const BigInteger& second_num) {
-    BigInteger num{second_num};
-    std::vector<long long> res_digits;
-    int extra = 0;
-    int cur_res;
+  // Sends the thread's new buffers to the heap while it exists, for values
+  // that outlive any arena, such as cached constants. Buffers that came from
+  // an arena still go back to it.
+  class HeapScope {
+   private:
+    bool was_suspended_ = Suspended();
 
-    if (num.digits_.size() < digits_.size()) {
-      num.digits_.resize(digits_.size(), 0);
-    } else if (num.digits_.size() > digits_.size()) {
-      digits_.resize(num.digits_.size(), 0);
+   public:
+    HeapScope() {
+      Suspended() = true;
     }
 
-    if (sign_ == positive && num.sign_ == positive) {
-      for (int i = 0; i <= (int)digits_.size() - 1; i++) {
-        cur_res = digits_[i] + num.digits_[i] + extra;
-        res_digits.push_back(cur_res % kBase);
-        extra = cur_res / kBase;
-      }
-
-      if (extra) {
-        res_digits.push_back(1);
-      }
+    HeapScope(const HeapScope&) = delete;
+    HeapScope& operator=(const HeapScope&) = delete;
 
-      digits_ = res_digits;
-      sign_ = positive;
-      NormalizeDigits();
-      return *this;
+    ~HeapScope() {
+      Suspended() = was_suspended_;
     }
+  };
 
-    if (sign_ == positive && num.sign_ == negative) {
-      bool swapped = false;
+  // A copy of value whose buffers live on the heap, for taking results out
+  // of the scope. Move it into its destination; copy-assigning would
+  // allocate from the arena again.
+  template <typename T>
+  T Export(const T& value) {
+    HeapScope heap;
+    return T(value);
+  }
+};
 
-      if (*this < -num) {
-        swapped = true;
-        std::swap(digits_, num.digits_);
-      }
+// Stateless allocator that takes memory from the thread's active
+// BigIntegerArena, or from the heap when there is none.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
 
-      for (int i = 0; i <= (int)num.digits_.size() - 1; i++) {
-        cur_res = digits_[i] - num.digits_[i] + extra;
-        extra = 0;
+  ArenaAllocator() = default;
 
-        if (cur_res < 0) {
-          extra = -1;
-          cur_res += kBase;
-        }
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>&) {}
 
-        res_digits.push_back(cur_res);
+  T* allocate(size_t n) {
+    BigIntegerArena* arena = BigIntegerArena::Active();
+    if (arena == nullptr || BigIntegerArena::Suspended()) {
+      return std::allocator<T>().allocate(n);
+    }
+    return static_cast<T*>(arena->Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* pointer, size_t n) {
+    for (BigIntegerArena* arena = BigIntegerArena::Active(); arena != nullptr;
+         arena = arena->previous_) {
+      if (arena->Deallocate(pointer, n * sizeof(T))) {
+        return;
       }
+    }
+    std::allocator<T>().deallocate(pointer, n);
+  }
 
-      if (extra == -1) {
-        extra = 0;
-        res_digits[0] = kBase - res_digits[0];
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>&) const {
+    return true;
+  }
+};
 
-        if (res_digits[0] == kBase) {
-          res_digits[0] = 0;
-          extra = 1;
-        }
+// A vector of trivially copyable values that keeps up to InlineCapacity of
+// them inside the object and only allocates once it grows past that.
+template <typename T, size_t InlineCapacity, typename Allocator = std::allocator<T>>
+class SmallVector {
+ private:
+  T* data_ = inline_;
+  size_t size_ = 0;
+  size_t capacity_ = InlineCapacity;
+  T inline_[InlineCapacity];
 
-        for (size_t i = 1; i < res_digits.size(); i++) {
-          res_digits[i] = kBase - 1 + extra - res_digits[i];
-        }
+  bool IsInline() const {
+    return data_ == inline_;
+  }
 
-        if (res_digits.back() == kBase - 1) {
-          res_digits.pop_back();
-        }
-      }
+  void Release() {
+    if (!IsInline()) {
+      Allocator().deallocate(data_, capacity_);
+    }
+    data_ = inline_;
+    capacity_ = InlineCapacity;
+  }
 
-      if (swapped) {
-        std::swap(digits_, num.digits_);
-      }
+  void Reallocate(size_t capacity) {
+    T* new_data = Allocator().allocate(capacity);
+    std::copy(data_, data_ + size_, new_data);
+    size_t size = size_;
+    Release();
+    data_ = new_data;
+    size_ = size;
+    capacity_ = capacity;
+  }
 
-      digits_ = res_digits;
-      sign_ = swapped ? negative : positive;
-      NormalizeDigits();
-      return *this;
+  void StealFrom(SmallVector& other) {
+    if (other.IsInline()) {
+      std::copy(other.data_, other.data_ + other.size_, inline_);
+    } else {
+      data_ = other.data_;
+      capacity_ = other.capacity_;
+      other.data_ = other.inline_;
+      other.capacity_ = InlineCapacity;
+    }
+    size_ = other.size_;
+    other.size_ = 0;
+  }
+
+ public:
+  using value_type = T;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector() {}
+
+  explicit SmallVector(size_t size, const T& value = T()) {
+    assign(size, value);
+  }
+
+  SmallVector(const T* first, const T* last) {
+    reserve(last - first);
+    std::copy(first, last, data_);
+    size_ = last - first;
+  }
+
+  SmallVector(std::initializer_list<T> values) : SmallVector(values.begin(), values.end()) {}
+
+  SmallVector(const SmallVector& other) : SmallVector(other.begin(), other.end()) {}
+
+  SmallVector(SmallVector&& other) noexcept {
+    StealFrom(other);
+  }
+
+  SmallVector& operator=(const SmallVector& other) {
+    if (this != &other) {
+      size_ = 0;
+      reserve(other.size_);
+      std::copy(other.begin(), other.end(), data_);
+      size_ = other.size_;
     }
+    return *this;
+  }
 
-    *this = -*this;
-    *this += -num;
-    *this = -*this;
+  SmallVector& operator=(SmallVector&& other) noexcept {
+    if (this != &other) {
+      Release();
+      StealFrom(other);
+    }
     return *this;
   }
 
-  BigInteger& operator-= (const BigInteger& second_num) {
-    return *this += -second_num;
+  ~SmallVector() {
+    Release();
   }
 
-  BigInteger& operator*= (const BigInteger& second_num) {
-    if (second_num.digits_.size() == 1 && second_num.digits_[0] == 0) {
-      digits_.clear();
-      digits_.push_back(0);
-      sign_ = positive;
+  size_t size() const {
+    return size_;
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  T* data() {
+    return data_;
+  }
+
+  const T* data() const {
+    return data_;
+  }
+
+  T& operator[](size_t index) {
+    return data_[index];
+  }
+
+  const T& operator[](size_t index) const {
+    return data_[index];
+  }
+
+  T& back() {
+    return data_[size_ - 1];
+  }
+
+  const T& back() const {
+    return data_[size_ - 1];
+  }
+
+  T* begin() {
+    return data_;
+  }
+
+  T* end() {
+    return data_ + size_;
+  }
+
+  const T* begin() const {
+    return data_;
+  }
+
+  const T* end() const {
+    return data_ + size_;
+  }
+
+  void reserve(size_t capacity) {
+    if (capacity > capacity_) {
+      Reallocate(std::max(capacity, 2 * capacity_));
     }
+  }
 
-    if (digits_.size() == 1 && digits_[0] == 0) {
-      return *this;
+  void push_back(const T& value) {
+    reserve(size_ + 1);
+    data_[size_++] = value;
+  }
+
+  void pop_back() {
+    --size_;
+  }
+
+  void resize(size_t size, const T& value = T()) {
+    reserve(size);
+    if (size > size_) {
+      std::fill(data_ + size_, data_ + size, value);
+    }
+    size_ = size;
+  }
+
+  void assign(size_t size, const T& value) {
+    size_ = 0;
+    resize(size, value);
+  }
+
+  void clear() {
+    size_ = 0;
+  }
+
+  bool operator==(const SmallVector& other) const {
+    return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+  }
+};
+
+using Limbs = SmallVector<long long, kInlineLimbs, ArenaAllocator<long long>>;
+
+std::atomic<size_t>& ThreadCountSetting() {
+  static std::atomic<size_t> count{1};
+  return count;
+}
+
+// Number of threads a single multiplication or division of at least
+// kParallelThreshold limbs may occupy, counting the calling one. The default
+// of 1 keeps all arithmetic on the calling thread.
+void SetThreadCount(size_t count) {
+  ThreadCountSetting() = std::max<size_t>(count, 1);
+}
+
+size_t ThreadCount() {
+  return ThreadCountSetting();
+}
+
+// Runs all tasks and returns when they are done. A task gets its own thread
+// only while fewer than ThreadCount() threads are busy, so nested calls fall
+// back to running on the caller instead of oversubscribing the machine.
+void RunTasks(const std::vector<std::function<void()>>& tasks) {
+  static std::atomic<size_t> busy_threads{1};
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(tasks.size());
+
+  auto run = [&tasks, &errors](size_t i) {
+    try {
+      tasks[i]();
+    } catch (...) {
+      errors[i] = std::current_exception();
     }
+  };
 
-    sign_ = sign_ * second_num.sign_;
+  BigIntegerArena* arena = BigIntegerArena::Active();
+  bool heap_only = BigIntegerArena::Suspended();
+  if (arena != nullptr) {
+    ++BigIntegerArena::SharingCount();
+  }
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    size_t busy = busy_threads;
+    while (i + 1 < tasks.size() && busy < ThreadCount() &&
+           !busy_threads.compare_exchange_weak(busy, busy + 1)) {
+    }
 
-    BigInteger copy = BigInteger(*this);
-    digits_.resize(second_num.digits_.size() + digits_.size());
-    std::fill(digits_.begin(), digits_.end(), 0);
-
-    for (size_t i = 0; i < second_num.digits_.size(); ++i) {
-      for (size_t j = 0; j < copy.digits_.size(); ++j) {
-        digits_[i + j] += second_num.digits_[i] * copy.digits_[j];
-        if (digits_[i + j] >= kBase) {
-          long long carry = digits_[i + j] / kBase;
-          digits_[i + j] %= kBase;
-          if (i + j + 1 != digits_.size()) {
-            digits_[i + j + 1] += carry;
-          }
-        }
+    if (i + 1 < tasks.size() && busy < ThreadCount()) {
+      threads.emplace_back([&run, i, arena, heap_only] {
+        BigIntegerArena::Active() = arena;
+        BigIntegerArena::Suspended() = heap_only;
+        run(i);
+        --busy_threads;
+      });
+    } else {
+      run(i);
+    }
+  }
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  if (arena != nullptr) {
+    --BigIntegerArena::SharingCount();
+  }
+  for (std::exception_ptr& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+// Limb kernels for the loops without a carry chain. The AVX2 versions are
+// compiled for that target only and are picked at runtime, so the header
+// still runs everywhere; BIGINTEGER_NO_SIMD keeps the scalar ones only.
+const size_t kSimdMinLimbs = 8;
+
+// One past the highest index where the two runs differ, 0 if they are equal.
+size_t FindMismatchScalar(const long long* first, const long long* second, size_t size) {
+  while (size != 0 && first[size - 1] == second[size - 1]) {
+    --size;
+  }
+  return size;
+}
+
+// target[i] += source[i] * factor; the limbs and the factor must fit in a
+// signed 32-bit integer and the sums must not overflow.
+void AccumulateScaledScalar(long long* target, const long long* source, size_t size,
+                            long long factor) {
+  for (size_t i = 0; i < size; ++i) {
+    target[i] += source[i] * factor;
+  }
+}
+
+#ifdef BIGINTEGER_AVX2_KERNELS
+bool HasAvx2() {
+  static const bool has_avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return has_avx2;
+}
+
+__attribute__((target("avx2")))
+size_t FindMismatchAvx2(const long long* first, const long long* second, size_t size) {
+  for (; size >= 4; size -= 4) {
+    __m256i first_limbs = _mm256_loadu_si256((const __m256i*)(first + size - 4));
+    __m256i second_limbs = _mm256_loadu_si256((const __m256i*)(second + size - 4));
+    __m256i equal = _mm256_cmpeq_epi64(first_limbs, second_limbs);
+    unsigned different = ~_mm256_movemask_pd(_mm256_castsi256_pd(equal)) & 0xF;
+    if (different != 0) {
+      return size - 4 + (32 - __builtin_clz(different));
+    }
+  }
+  return FindMismatchScalar(first, second, size);
+}
+
+__attribute__((target("avx2")))
+void AccumulateScaledAvx2(long long* target, const long long* source, size_t size,
+                          long long factor) {
+  __m256i scale = _mm256_set1_epi64x(factor);
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m256i source_limbs = _mm256_loadu_si256((const __m256i*)(source + i));
+    __m256i target_limbs = _mm256_loadu_si256((const __m256i*)(target + i));
+    target_limbs = _mm256_add_epi64(target_limbs, _mm256_mul_epi32(source_limbs, scale));
+    _mm256_storeu_si256((__m256i*)(target + i), target_limbs);
+  }
+  AccumulateScaledScalar(target + i, source + i, size - i, factor);
+}
+#endif
+
+size_t FindMismatch(const long long* first, const long long* second, size_t size) {
+#ifdef BIGINTEGER_AVX2_KERNELS
+  if (size >= kSimdMinLimbs && HasAvx2()) {
+    return FindMismatchAvx2(first, second, size);
+  }
+#endif
+  return FindMismatchScalar(first, second, size);
+}
+
+void AccumulateScaled(long long* target, const long long* source, size_t size,
+                      long long factor) {
+#ifdef BIGINTEGER_AVX2_KERNELS
+  if (size >= kSimdMinLimbs && HasAvx2()) {
+    AccumulateScaledAvx2(target, source, size, factor);
+    return;
+  }
+#endif
+  AccumulateScaledScalar(target, source, size, factor);
+}
+
+template <uint32_t Modulus, uint32_t PrimitiveRoot>
+class NttPrime {
+ private:
+  // Level k holds the powers of the primitive 2^(k+1)-th root of unity.
+  // Levels are shared by all later transforms; each one is built once under
+  // the lock and never modified again, so transforms may run concurrently.
+  static std::vector<const uint32_t*> RootLevels(size_t size) {
+    static std::mutex mutex;
+    static std::deque<std::vector<uint32_t>> levels;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (size_t len = (size_t)1 << levels.size(); len < size; len <<= 1) {
+      std::vector<uint32_t> roots(len, 1);
+      uint32_t root = Power(PrimitiveRoot, (Modulus - 1) / (2 * len));
+      for (size_t j = 1; j < len; ++j) {
+        roots[j] = (uint64_t)roots[j - 1] * root % Modulus;
       }
+      levels.push_back(std::move(roots));
     }
 
-    NormalizeDigits();
+    std::vector<const uint32_t*> result;
+    for (size_t level = 0; ((size_t)1 << level) < size; ++level) {
+      result.push_back(levels[level].data());
+    }
+    return result;
+  }
 
-    return *this;
+ public:
+  static const uint32_t kModulus = Modulus;
+
+  static uint32_t Power(uint64_t base, uint64_t exponent) {
+    uint64_t result = 1;
+    base %= Modulus;
+
+    for (; exponent != 0; exponent >>= 1) {
+      if (exponent & 1) {
+        result = result * base % Modulus;
+      }
+      base = base * base % Modulus;
+    }
+
+    return result;
   }
 
-  BigInteger& operator/= (const BigInteger& second_num) {
-    std::vector<long long> res_digits;
-    BigInteger current = 0;
-    Sign res_sign = sign_ * second_num.sign_;
-    BigInteger num{second_num.digits_, positive};
-
-    for (int i = (int)digits_.size() - 1; i >= 0; i--) {
-      current *= kBase;
-      current += digits_[i];
-
-      int lower = -1;
-      int upper = kBase;
-      int middle;
-      BigInteger possible_res;
-      while (lower < upper - 1) {
-        middle = (lower + upper) / 2;
-        possible_res = num;
-        possible_res *= middle;
-        if (possible_res <= current) {
-          lower = middle;
-        } else {
-          upper = middle;
+  static void Transform(std::vector<uint32_t>& values, bool inverse) {
+    size_t size = values.size();
+    std::vector<const uint32_t*> levels = RootLevels(size);
+
+    for (size_t i = 1, j = 0; i < size; ++i) {
+      size_t bit = size >> 1;
+      for (; j & bit; bit >>= 1) {
+        j ^= bit;
+      }
+      j ^= bit;
+
+      if (i < j) {
+        std::swap(values[i], values[j]);
+      }
+    }
+
+    for (size_t len = 1, level = 0; len < size; len <<= 1, ++level) {
+      const uint32_t* roots = levels[level];
+      for (size_t start = 0; start < size; start += 2 * len) {
+        for (size_t j = 0; j < len; ++j) {
+          uint32_t first = values[start + j];
+          uint32_t second = (uint64_t)values[start + j + len] * roots[j] % Modulus;
+          values[start + j] = first + second >= Modulus ? first + second - Modulus : first + second;
+          values[start + j + len] = first >= second ? first - second : first + Modulus - second;
         }
       }
-      res_digits.push_back(lower);
-      possible_res = num;
-      possible_res *= lower;
-      current -= possible_res;
     }
 
-    std::reverse(res_digits.begin(), res_digits.end());
+    if (inverse) {
+      std::reverse(values.begin() + 1, values.end());
+      uint64_t size_inverse = Power(size, Modulus - 2);
+      for (uint32_t& value : values) {
+        value = value * size_inverse % Modulus;
+      }
+    }
+  }
 
-    digits_ = res_digits;
-    sign_ = res_sign;
+  // Cyclic convolution of the limbs modulo this prime; size is the padded
+  // power-of-two transform length.
+  static std::vector<uint32_t> Convolve(const Limbs& first, const Limbs& second, size_t size) {
+    std::vector<uint32_t> first_values(size, 0);
+    std::vector<uint32_t> second_values;
+    auto transform_first = [&first, &first_values] {
+      for (size_t i = 0; i < first.size(); ++i) {
+        first_values[i] = first[i] % Modulus;
+      }
+      Transform(first_values, false);
+    };
+    auto transform_second = [&second, &second_values, size] {
+      second_values.assign(size, 0);
+      for (size_t i = 0; i < second.size(); ++i) {
+        second_values[i] = second[i] % Modulus;
+      }
+      Transform(second_values, false);
+    };
 
-    NormalizeDigits();
-    
+    if (&first == &second) {
+      transform_first();
+      for (uint32_t& value : first_values) {
+        value = (uint64_t)value * value % Modulus;
+      }
+    } else {
+      if (size >= kParallelThreshold && ThreadCount() > 1) {
+        RunTasks({transform_first, transform_second});
+      } else {
+        transform_first();
+        transform_second();
+      }
+
+      for (size_t i = 0; i < size; ++i) {
+        first_values[i] = (uint64_t)first_values[i] * second_values[i] % Modulus;
+      }
+    }
+
+    Transform(first_values, true);
+    return first_values;
+  }
+};
+
+using NttFirstPrime = NttPrime<754974721, 11>;
+using NttSecondPrime = NttPrime<167772161, 3>;
+using NttThirdPrime = NttPrime<469762049, 3>;
+
+#ifdef BIGINTEGER_CACHE_HASH
+// Hash cached inside a value, 0 while there is none. Hash() on a shared
+// const value stores into it, so the accesses are relaxed atomics; threads
+// racing to fill it store the same number. A computed hash of 0 is kept as
+// 1 so that it is cached like any other.
+class HashCache {
+ private:
+  mutable std::atomic<size_t> hash_{0};
+
+ public:
+  HashCache() {}
+
+  HashCache(const HashCache& other) noexcept : hash_(other.Load()) {}
+
+  HashCache& operator=(const HashCache& other) noexcept {
+    hash_.store(other.Load(), std::memory_order_relaxed);
     return *this;
   }
 
-  BigInteger& operator%= (const BigInteger& second_num) {
-    BigInteger dividable_part = *this;
-    dividable_part /= second_num;
-    dividable_part *= second_num;
-    return *this -= dividable_part;
+  size_t Load() const {
+    return hash_.load(std::memory_order_relaxed);
   }
 
-  BigInteger operator++ (int) {
-    BigInteger temp = *this;
-    *this += 1;
-    return temp;
+  size_t Store(size_t hash) const {
+    hash = hash == 0 ? 1 : hash;
+    hash_.store(hash, std::memory_order_relaxed);
+    return hash;
+  }
+
+  void Clear() const {
+    hash_.store(0, std::memory_order_relaxed);
+  }
+};
+#endif
+
+class BigInteger;
+
+// One term of a BigIntegerSum: first * second, or just first when second is
+// null, subtracted if negated.
+struct FusedTerm {
+  const BigInteger* first;
+  const BigInteger* second;
+  bool negated;
+};
+
+class BigInteger {
+ private:
+  Limbs digits_;
+  Sign sign_ = positive;
+#ifdef BIGINTEGER_CACHE_HASH
+  // Empty until Hash() is asked for; every change of value resets it.
+  HashCache hash_;
+#endif
+
+  void ForgetHash() const {
+#ifdef BIGINTEGER_CACHE_HASH
+    hash_.Clear();
+#endif
   }
 
-  BigInteger operator-- (int) {
-    BigInteger temp = *this;
-    *this -= 1;
-    return temp;
+  // 64x64 -> 128 bit multiply folded back to 64 bits.
+  static uint64_t MixHash(uint64_t first, uint64_t second) {
+    unsigned __int128 product = (unsigned __int128)first * second;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+  }
+
+  static size_t CombineHashes(uint64_t first, uint64_t second) {
+    uint64_t hash = MixHash(first ^ 0xa0761d6478bd642full, second ^ 0xe7037ed1a0b428dbull);
+    return hash != 0 ? hash : 1;
+  }
+
+  // Limbs fit in 32 bits, so one multiply absorbs four of them.
+  size_t ComputeHash() const {
+    auto limb = [this](size_t i) {
+      return i < digits_.size() ? (uint64_t)digits_[i] : 0;
+    };
+
+    uint64_t hash = digits_.size() << 1 | (sign_ == negative ? 1 : 0);
+    for (size_t i = 0; i < digits_.size(); i += 4) {
+      hash = MixHash((limb(i) | limb(i + 1) << 32) ^ 0x8ebc6af09c88c6e3ull,
+                     (limb(i + 2) | limb(i + 3) << 32) ^ hash ^ 0x589965cc75374cc3ull);
+    }
+    return CombineHashes(hash, digits_.size());
+  }
+
+  void NormalizeDigits() {
+    ForgetHash();
+    while (!digits_.empty() && digits_.back() == 0) {
+      digits_.pop_back();
+    }
+
+    if (digits_.empty()) {
+      digits_.push_back(0);
+      sign_ = positive;
+    }
+  }
+
+  void BuildFromUll(unsigned long long num) {
+    while (num) {
+      digits_.push_back(std::abs((int)(num % kBase)));
+      num /= kBase;
+    }
+  }
+
+  BigInteger(Limbs digits, Sign sign) : digits_(std::move(digits)), sign_(sign) {}
+
+  static void TrimDigits(Limbs& digits) {
+    while (!digits.empty() && digits.back() == 0) {
+      digits.pop_back();
+    }
+  }
+
+  static Limbs ConvertRadix(const Limbs& digits, long long from, long long to) {
+    Limbs result;
+
+    for (int i = (int)digits.size() - 1; i >= 0; --i) {
+      long long carry = digits[i];
+      for (long long& digit : result) {
+        long long current = digit * from + carry;
+        digit = current % to;
+        carry = current / to;
+      }
+      while (carry != 0) {
+        result.push_back(carry % to);
+        carry /= to;
+      }
+    }
+
+    return result;
+  }
+
+  static Limbs FromDecimalChunks(Limbs chunks) {
+    if (kBase == kDecimalBase) {
+      return chunks;
+    }
+
+    return ConvertRadix(chunks, kDecimalBase, kBase);
+  }
+
+  static Limbs SliceDigits(const Limbs& digits, size_t begin, size_t end) {
+    begin = std::min(begin, digits.size());
+    end = std::min(end, digits.size());
+    Limbs slice(digits.begin() + begin, digits.begin() + end);
+    TrimDigits(slice);
+    return slice;
+  }
+
+  static void AddDigitsTo(Limbs& target, const Limbs& addend, size_t shift = 0) {
+    if (target.size() < addend.size() + shift) {
+      target.resize(addend.size() + shift, 0);
+    }
+
+    long long carry = 0;
+    size_t i = 0;
+    for (; i < addend.size(); ++i) {
+      target[i + shift] += addend[i] + carry;
+      carry = target[i + shift] >= kBase ? 1 : 0;
+      target[i + shift] -= carry * kBase;
+    }
+
+    for (i += shift; carry != 0; ++i) {
+      if (i == target.size()) {
+        target.push_back(0);
+      }
+      target[i] += carry;
+      carry = target[i] >= kBase ? 1 : 0;
+      target[i] -= carry * kBase;
+    }
+  }
+
+  static void SubtractDigitsFrom(Limbs& target, const Limbs& subtrahend) {
+    long long borrow = 0;
+    for (size_t i = 0; i < target.size() && (i < subtrahend.size() || borrow != 0); ++i) {
+      target[i] -= (i < subtrahend.size() ? subtrahend[i] : 0) + borrow;
+      borrow = target[i] < 0 ? 1 : 0;
+      target[i] += borrow * kBase;
+    }
+
+    TrimDigits(target);
+  }
+
+  // target = subtrahend - target, for |target| <= |subtrahend|.
+  static void SubtractDigitsFromReversed(Limbs& target, const Limbs& subtrahend) {
+    target.resize(std::max(target.size(), subtrahend.size()), 0);
+
+    long long borrow = 0;
+    for (size_t i = 0; i < target.size(); ++i) {
+      target[i] = (i < subtrahend.size() ? subtrahend[i] : 0) - target[i] - borrow;
+      borrow = target[i] < 0 ? 1 : 0;
+      target[i] += borrow * kBase;
+    }
+
+    TrimDigits(target);
+  }
+
+  // Adds a signed magnitude in place; both helpers used here tolerate
+  // digits aliasing digits_.
+  void AddSigned(const Limbs& digits, Sign digits_sign) {
+    if (sign_ == digits_sign) {
+      AddDigitsTo(digits_, digits);
+    } else if (CompareDigits(digits_, digits) >= 0) {
+      SubtractDigitsFrom(digits_, digits);
+    } else {
+      SubtractDigitsFromReversed(digits_, digits);
+      sign_ = digits_sign;
+    }
+
+    NormalizeDigits();
+  }
+
+  // Carry-save: rows of products are accumulated without carrying for as
+  // long as a column is sure to fit, and only then are the columns reduced.
+  // With the default radices that is one division per column every 8-9 rows.
+  static Limbs MultiplySchoolbook(const Limbs& first, const Limbs& second) {
+    Limbs result;
+    MultiplySchoolbookInto(first, second, result);
+    return result;
+  }
+
+  // MultiplySchoolbook into an existing buffer, which keeps its capacity.
+  // result must not alias either factor.
+  static void MultiplySchoolbookInto(const Limbs& first, const Limbs& second, Limbs& result) {
+    const size_t rows_per_carry =
+        (INT64_MAX - kBase) / ((long long)(kBase - 1) * (kBase - 1));
+    result.assign(first.size() + second.size(), 0);
+
+    for (size_t row = 0; row < second.size(); row += rows_per_carry) {
+      size_t row_end = std::min(second.size(), row + rows_per_carry);
+      for (size_t i = row; i < row_end; ++i) {
+        AccumulateScaled(result.data() + i, first.data(), first.size(), second[i]);
+      }
+
+      long long carry = 0;
+      for (size_t i = row; i < row_end + first.size(); ++i) {
+        long long current = result[i] + carry;
+        carry = current / kBase;
+        result[i] = current % kBase;
+      }
+    }
+
+    TrimDigits(result);
+  }
+
+  // Builds a sum of signed products in a single limb buffer. Products below
+  // the Karatsuba threshold are accumulated row by row as in
+  // MultiplySchoolbook, subtracted ones with negative factors, and the
+  // columns are carried with floored division every rows_per_carry rows, so
+  // only products big enough for the recursive algorithms get a temporary.
+  // The spare limb at the top is never reduced, so it ends up holding the
+  // sign as well; a negative total is complemented back to a magnitude.
+  static Sign EvaluateFused(const FusedTerm* terms, size_t count, Limbs& result) {
+    const size_t rows_per_carry =
+        (INT64_MAX - kBase) / ((long long)(kBase - 1) * (kBase - 1));
+    size_t size = 0;
+    for (size_t i = 0; i < count; ++i) {
+      size = std::max(size, terms[i].first->digits_.size() +
+                                (terms[i].second ? terms[i].second->digits_.size() : 0));
+    }
+    result.assign(size + 1, 0);
+
+    auto carry = [&result]() {
+      long long carry = 0;
+      for (size_t i = 0; i + 1 < result.size(); ++i) {
+        long long current = result[i] + carry;
+        carry = current / kBase;
+        result[i] = current % kBase;
+        if (result[i] < 0) {
+          result[i] += kBase;
+          --carry;
+        }
+      }
+      result.back() += carry;
+    };
+
+    size_t pending_rows = 0;
+    auto add_row = [&](const Limbs& source, size_t shift, long long factor) {
+      if (pending_rows == rows_per_carry) {
+        carry();
+        pending_rows = 0;
+      }
+      AccumulateScaled(result.data() + shift, source.data(), source.size(), factor);
+      ++pending_rows;
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+      const BigInteger& first = *terms[i].first;
+      if (!terms[i].second) {
+        add_row(first.digits_, 0, terms[i].negated != (first.sign_ == negative) ? -1 : 1);
+        continue;
+      }
+
+      const BigInteger& second = *terms[i].second;
+      long long direction = terms[i].negated != (first.sign_ != second.sign_) ? -1 : 1;
+      const Limbs& longer = first.digits_.size() < second.digits_.size() ? second.digits_ : first.digits_;
+      const Limbs& shorter = first.digits_.size() < second.digits_.size() ? first.digits_ : second.digits_;
+      if (shorter.size() < kKaratsubaThreshold) {
+        for (size_t row = 0; row < shorter.size(); ++row) {
+          if (shorter[row] != 0) {
+            add_row(longer, row, direction * shorter[row]);
+          }
+        }
+      } else {
+        add_row(MultiplyDigits(longer, shorter), 0, direction);
+      }
+    }
+    carry();
+
+    Sign sign = positive;
+    if (result.back() < 0) {
+      long long borrow = 0;
+      for (size_t i = 0; i + 1 < result.size(); ++i) {
+        result[i] = -result[i] - borrow;
+        borrow = result[i] < 0 ? 1 : 0;
+        result[i] += borrow * kBase;
+      }
+      result.back() = -result.back() - borrow;
+      sign = negative;
+    }
+
+    TrimDigits(result);
+    return sign;
+  }
+
+  // Writes into the limbs destination already owns unless it is one of the
+  // operands.
+  static void EvaluateFused(const FusedTerm* terms, size_t count, BigInteger& destination) {
+    for (size_t i = 0; i < count; ++i) {
+      if (terms[i].first == &destination || terms[i].second == &destination) {
+        BigInteger result;
+        EvaluateFused(terms, count, result);
+        destination = std::move(result);
+        return;
+      }
+    }
+
+    destination.sign_ = EvaluateFused(terms, count, destination.digits_);
+    destination.NormalizeDigits();
+  }
+
+  // Multiplies a long operand by a much shorter one chunk by chunk, so that
+  // every recursive product stays balanced.
+  static Limbs MultiplyUnbalanced(const Limbs& longer, const Limbs& shorter) {
+    Limbs result;
+
+    for (size_t begin = 0; begin < longer.size(); begin += shorter.size()) {
+      Limbs chunk = SliceDigits(longer, begin, begin + shorter.size());
+      AddDigitsTo(result, MultiplyDigits(chunk, shorter), begin);
+    }
+
+    TrimDigits(result);
+    return result;
+  }
+
+  static Limbs MultiplyKaratsuba(const Limbs& first, const Limbs& second) {
+    size_t half = std::max(first.size(), second.size()) / 2;
+    Limbs first_low = SliceDigits(first, 0, half);
+    Limbs first_high = SliceDigits(first, half, first.size());
+    Limbs second_low = SliceDigits(second, 0, half);
+    Limbs second_high = SliceDigits(second, half, second.size());
+
+    Limbs low = MultiplyDigits(first_low, second_low);
+    Limbs high = MultiplyDigits(first_high, second_high);
+
+    AddDigitsTo(first_low, first_high);
+    AddDigitsTo(second_low, second_high);
+    Limbs middle = MultiplyDigits(first_low, second_low);
+    SubtractDigitsFrom(middle, low);
+    SubtractDigitsFrom(middle, high);
+
+    Limbs result = low;
+    AddDigitsTo(result, middle, half);
+    AddDigitsTo(result, high, 2 * half);
+    TrimDigits(result);
+    return result;
+  }
+
+  // Toom-Cook-3 with evaluation points 0, 1, -1, -2 and infinity. The
+  // evaluated values may be negative, so they are kept as signed BigIntegers.
+  static Limbs MultiplyToomCook3(const Limbs& first, const Limbs& second) {
+    size_t part = (std::max(first.size(), second.size()) + 2) / 3;
+
+    BigInteger first_parts[3];
+    BigInteger second_parts[3];
+    for (size_t i = 0; i < 3; ++i) {
+      first_parts[i] = FromDigits(SliceDigits(first, i * part, (i + 1) * part));
+      second_parts[i] = FromDigits(SliceDigits(second, i * part, (i + 1) * part));
+    }
+
+    BigInteger values[5];
+    BigInteger second_values[5];
+    for (int k = 0; k < 2; ++k) {
+      BigInteger* parts = k == 0 ? first_parts : second_parts;
+      BigInteger* evaluated = k == 0 ? values : second_values;
+      BigInteger at_one = parts[0];
+      at_one += parts[2];
+      BigInteger at_minus_one = at_one;
+      at_one += parts[1];
+      at_minus_one -= parts[1];
+      BigInteger at_minus_two = at_minus_one;
+      at_minus_two += parts[2];
+      at_minus_two *= 2;
+      at_minus_two -= parts[0];
+
+      evaluated[0] = parts[0];
+      evaluated[1] = at_one;
+      evaluated[2] = at_minus_one;
+      evaluated[3] = at_minus_two;
+      evaluated[4] = parts[2];
+    }
+
+    // The five pointwise products are independent of each other.
+    if (part >= kParallelThreshold && ThreadCount() > 1) {
+      std::vector<std::function<void()>> products;
+      for (size_t i = 0; i < 5; ++i) {
+        products.push_back([&values, &second_values, i] { values[i] *= second_values[i]; });
+      }
+      RunTasks(products);
+    } else {
+      for (size_t i = 0; i < 5; ++i) {
+        values[i] *= second_values[i];
+      }
+    }
+
+    BigInteger coef0 = values[0];
+    BigInteger coef4 = values[4];
+    BigInteger coef3 = values[3];
+    coef3 -= values[1];
+    coef3.DivideBySmall(3);
+    BigInteger coef1 = values[1];
+    coef1 -= values[2];
+    coef1.DivideBySmall(2);
+    BigInteger coef2 = values[2];
+    coef2 -= values[0];
+    coef3 -= coef2;
+    coef3 = -coef3;
+    coef3.DivideBySmall(2);
+    BigInteger doubled_coef4 = coef4;
+    doubled_coef4 *= 2;
+    coef3 += doubled_coef4;
+    coef2 += coef1;
+    coef2 -= coef4;
+    coef1 -= coef3;
+
+    BigInteger coefs[5] = {coef0, coef1, coef2, coef3, coef4};
+    Limbs result;
+    for (size_t i = 0; i < 5; ++i) {
+      if (coefs[i]) {
+        AddDigitsTo(result, coefs[i].digits_, i * part);
+      }
+    }
+
+    TrimDigits(result);
+    return result;
+  }
+
+  // Exact product through three NTTs, recombined by Garner's CRT. The three
+  // moduli multiply to about 6e25, which bounds every convolution coefficient
+  // for transforms up to kNttMaxSize.
+  static Limbs MultiplyNtt(const Limbs& first, const Limbs& second) {
+    const uint64_t first_mod = NttFirstPrime::kModulus;
+    const uint64_t second_mod = NttSecondPrime::kModulus;
+    const uint64_t third_mod = NttThirdPrime::kModulus;
+    const uint64_t first_inverse = NttSecondPrime::Power(first_mod, second_mod - 2);
+    const uint64_t both_inverse = NttThirdPrime::Power(first_mod * second_mod, third_mod - 2);
+
+    size_t result_size = first.size() + second.size();
+    size_t size = 1;
+    while (size < result_size - 1) {
+      size <<= 1;
+    }
+
+    std::vector<uint32_t> first_residues;
+    std::vector<uint32_t> second_residues;
+    std::vector<uint32_t> third_residues;
+    auto convolve_first = [&] {
+      first_residues = NttFirstPrime::Convolve(first, second, size);
+    };
+    auto convolve_second = [&] {
+      second_residues = NttSecondPrime::Convolve(first, second, size);
+    };
+    auto convolve_third = [&] {
+      third_residues = NttThirdPrime::Convolve(first, second, size);
+    };
+
+    if (result_size >= kParallelThreshold && ThreadCount() > 1) {
+      RunTasks({convolve_first, convolve_second, convolve_third});
+    } else {
+      convolve_first();
+      convolve_second();
+      convolve_third();
+    }
+
+    Limbs result(result_size, 0);
+    unsigned __int128 carry = 0;
+
+    for (size_t i = 0; i < result_size; ++i) {
+      if (i + 1 < result_size) {
+        uint64_t x1 = first_residues[i];
+        uint64_t x2 = (second_residues[i] + second_mod - x1 % second_mod) % second_mod *
+                      first_inverse % second_mod;
+        uint64_t partial = (x1 + x2 % third_mod * (first_mod % third_mod)) % third_mod;
+        uint64_t x3 = (third_residues[i] + third_mod - partial) % third_mod *
+                      both_inverse % third_mod;
+        carry += x1 + x2 * first_mod + (unsigned __int128)x3 * first_mod * second_mod;
+      }
+
+      result[i] = carry % kBase;
+      carry /= kBase;
+    }
+
+    TrimDigits(result);
+    return result;
+  }
+
+  static Limbs MultiplyDigits(const Limbs& first, const Limbs& second) {
+    if (first.empty() || second.empty()) {
+      return {};
+    }
+
+    const Limbs& longer = first.size() < second.size() ? second : first;
+    const Limbs& shorter = first.size() < second.size() ? first : second;
+
+    if (shorter.size() < kKaratsubaThreshold) {
+      return MultiplySchoolbook(longer, shorter);
+    }
+
+    if (shorter.size() >= kNttThreshold && longer.size() + shorter.size() <= kNttMaxSize) {
+      return MultiplyNtt(longer, shorter);
+    }
+
+    if (2 * shorter.size() <= longer.size()) {
+      return MultiplyUnbalanced(longer, shorter);
+    }
+
+    if (shorter.size() < kToom3Threshold) {
+      return MultiplyKaratsuba(longer, shorter);
+    }
+
+    return MultiplyToomCook3(longer, shorter);
+  }
+
+  // MultiplyDigits into an existing buffer, which keeps its capacity. Below
+  // the Karatsuba threshold the product is accumulated there directly; the
+  // recursive tiers build it in temporaries of their own and it is copied
+  // over. result must not alias either factor.
+  static void MultiplyDigitsInto(const Limbs& first, const Limbs& second, Limbs& result) {
+    if (std::min(first.size(), second.size()) < kKaratsubaThreshold) {
+      if (first.empty() || second.empty()) {
+        result.clear();
+      } else if (first.size() < second.size()) {
+        MultiplySchoolbookInto(second, first, result);
+      } else {
+        MultiplySchoolbookInto(first, second, result);
+      }
+      return;
+    }
+
+    result = MultiplyDigits(first, second);
+  }
+
+  static BigInteger FromDigits(Limbs digits) {
+    BigInteger result{std::move(digits), positive};
+    result.NormalizeDigits();
+    return result;
+  }
+
+  static long long DivideDigitsBySmall(Limbs& digits, long long divisor) {
+    long long remainder = 0;
+
+    for (int i = (int)digits.size() - 1; i >= 0; --i) {
+      long long current = remainder * kBase + digits[i];
+      digits[i] = current / divisor;
+      remainder = current % divisor;
+    }
+
+    TrimDigits(digits);
+    return remainder;
+  }
+
+  long long DivideBySmall(long long divisor) {
+    long long remainder = DivideDigitsBySmall(digits_, divisor);
+    NormalizeDigits();
+    return remainder;
+  }
+
+  static int CompareDigits(const Limbs& first, const Limbs& second) {
+    if (first.size() != second.size()) {
+      return first.size() < second.size() ? -1 : 1;
+    }
+
+    size_t mismatch = FindMismatch(first.data(), second.data(), first.size());
+    if (mismatch == 0) {
+      return 0;
+    }
+    return first[mismatch - 1] < second[mismatch - 1] ? -1 : 1;
+  }
+
+  // Knuth's Algorithm D: both operands are scaled so that the top divisor
+  // limb is at least kBase / 2, after which the quotient limb estimated from
+  // the top two limbs is off by at most two.
+  static void DivModKnuth(const Limbs& dividend, const Limbs& divisor,
+                          Limbs& quotient, Limbs& remainder) {
+    size_t divisor_size = divisor.size();
+    size_t quotient_size = dividend.size() - divisor_size + 1;
+    long long scale = kBase / (divisor.back() + 1);
+
+    Limbs current(dividend.size() + 1, 0);
+    Limbs scaled_divisor(divisor_size, 0);
+    long long carry = 0;
+    for (size_t i = 0; i < dividend.size(); ++i) {
+      long long product = dividend[i] * scale + carry;
+      current[i] = product % kBase;
+      carry = product / kBase;
+    }
+    current.back() = carry;
+    carry = 0;
+    for (size_t i = 0; i < divisor_size; ++i) {
+      long long product = divisor[i] * scale + carry;
+      scaled_divisor[i] = product % kBase;
+      carry = product / kBase;
+    }
+
+    long long top = scaled_divisor[divisor_size - 1];
+    long long second_top = scaled_divisor[divisor_size - 2];
+    quotient.assign(quotient_size, 0);
+
+    for (int j = (int)quotient_size - 1; j >= 0; --j) {
+      long long head = current[j + divisor_size] * kBase + current[j + divisor_size - 1];
+      long long estimate = head / top;
+      long long rest = head % top;
+
+      while (estimate >= kBase ||
+             estimate * second_top > rest * kBase + current[j + divisor_size - 2]) {
+        --estimate;
+        rest += top;
+        if (rest >= kBase) {
+          break;
+        }
+      }
+
+      long long borrow = 0;
+      carry = 0;
+      for (size_t i = 0; i < divisor_size; ++i) {
+        long long product = estimate * scaled_divisor[i] + carry;
+        carry = product / kBase;
+        long long difference = current[i + j] - product % kBase - borrow;
+        borrow = difference < 0 ? 1 : 0;
+        current[i + j] = difference + borrow * kBase;
+      }
+      long long head_difference = current[j + divisor_size] - carry - borrow;
+
+      if (head_difference < 0) {
+        --estimate;
+        carry = 0;
+        for (size_t i = 0; i < divisor_size; ++i) {
+          current[i + j] += scaled_divisor[i] + carry;
+          carry = current[i + j] >= kBase ? 1 : 0;
+          current[i + j] -= carry * kBase;
+        }
+        head_difference += carry;
+      }
+
+      current[j + divisor_size] = head_difference;
+      quotient[j] = estimate;
+    }
+
+    current.resize(divisor_size);
+    DivideDigitsBySmall(current, scale);
+    remainder = std::move(current);
+    TrimDigits(quotient);
+  }
+
+  static Limbs ShiftDigits(const Limbs& digits, size_t shift) {
+    if (digits.empty()) {
+      return {};
+    }
+
+    Limbs result(shift + digits.size(), 0);
+    std::copy(digits.begin(), digits.end(), result.begin() + shift);
+    return result;
+  }
+
+  // One step of the Burnikel-Ziegler recursion. The divisor must have its top
+  // limb at least kBase / 2 and the dividend must be below
+  // kBase^quotient_size * divisor, so the quotient has quotient_size limbs.
+  static void DivModRecursive(const Limbs& dividend, const Limbs& divisor, size_t quotient_size,
+                              Limbs& quotient, Limbs& remainder) {
+    if (quotient_size < kBurnikelZieglerThreshold || divisor.size() < kBurnikelZieglerThreshold) {
+      DivModDigits(dividend, divisor, quotient, remainder, false);
+      return;
+    }
+
+    size_t half = quotient_size / 2;
+    Limbs divisor_low = SliceDigits(divisor, 0, half);
+    Limbs divisor_high = SliceDigits(divisor, half, divisor.size());
+    BigInteger full_divisor = FromDigits(divisor);
+    BigInteger shifted_divisor = FromDigits(ShiftDigits(divisor, half));
+
+    Limbs high_quotient;
+    Limbs high_remainder;
+    DivModRecursive(SliceDigits(dividend, 2 * half, dividend.size()), divisor_high,
+                    quotient_size - half, high_quotient, high_remainder);
+
+    BigInteger current = FromDigits(ShiftDigits(high_remainder, 2 * half));
+    current += FromDigits(SliceDigits(dividend, 0, 2 * half));
+    current -= FromDigits(ShiftDigits(MultiplyDigits(high_quotient, divisor_low), half));
+    BigInteger high_part = FromDigits(high_quotient);
+    while (current.sign_ == negative) {
+      current += shifted_divisor;
+      --high_part;
+    }
+
+    Limbs low_quotient;
+    Limbs low_remainder;
+    DivModRecursive(SliceDigits(current.digits_, half, current.digits_.size()), divisor_high,
+                    half, low_quotient, low_remainder);
+
+    BigInteger rest = FromDigits(ShiftDigits(low_remainder, half));
+    rest += FromDigits(SliceDigits(current.digits_, 0, half));
+    rest -= FromDigits(MultiplyDigits(low_quotient, divisor_low));
+    BigInteger low_part = FromDigits(low_quotient);
+    while (rest.sign_ == negative) {
+      rest += full_divisor;
+      --low_part;
+    }
+
+    quotient = ShiftDigits(high_part.digits_, half);
+    AddDigitsTo(quotient, low_part.digits_);
+    TrimDigits(quotient);
+    remainder = rest.digits_;
+    TrimDigits(remainder);
+  }
+
+  // Splits the dividend into blocks of divisor size and feeds them to the
+  // recursive step from the top, carrying the remainder between blocks.
+  static void DivModBurnikelZiegler(const Limbs& dividend, const Limbs& divisor,
+                                    Limbs& quotient, Limbs& remainder) {
+    size_t block = divisor.size();
+    long long scale = kBase / (divisor.back() + 1);
+    Limbs scaled_dividend = MultiplyDigits(dividend, {scale});
+    Limbs scaled_divisor = MultiplyDigits(divisor, {scale});
+
+    size_t block_count = (scaled_dividend.size() + block - 1) / block;
+    quotient.assign(block_count * block, 0);
+    remainder.clear();
+
+    for (int i = (int)block_count - 1; i >= 0; --i) {
+      Limbs current = ShiftDigits(remainder, block);
+      AddDigitsTo(current, SliceDigits(scaled_dividend, i * block, (i + 1) * block));
+      TrimDigits(current);
+
+      Limbs block_quotient;
+      DivModRecursive(current, scaled_divisor, block, block_quotient, remainder);
+      std::copy(block_quotient.begin(), block_quotient.end(), quotient.begin() + i * block);
+    }
+
+    TrimDigits(quotient);
+    DivideDigitsBySmall(remainder, scale);
+  }
+
+  static void DivModDigits(Limbs dividend, Limbs divisor, Limbs& quotient, Limbs& remainder,
+                           bool allow_recursive = true) {
+    TrimDigits(dividend);
+    TrimDigits(divisor);
+
+    if (CompareDigits(dividend, divisor) < 0) {
+      quotient.clear();
+      remainder = std::move(dividend);
+      return;
+    }
+
+    if (divisor.size() == 1) {
+      long long small_remainder = DivideDigitsBySmall(dividend, divisor[0]);
+      quotient = std::move(dividend);
+      remainder.assign(1, small_remainder);
+      TrimDigits(remainder);
+      return;
+    }
+
+    if (allow_recursive && divisor.size() >= kBurnikelZieglerThreshold &&
+        dividend.size() - divisor.size() >= kBurnikelZieglerThreshold) {
+      DivModBurnikelZiegler(dividend, divisor, quotient, remainder);
+      return;
+    }
+
+    DivModKnuth(dividend, divisor, quotient, remainder);
+  }
+
+  // first * first_coef + second * second_coef, where the coefficients have
+  // opposite signs and the result is known to be non-negative.
+  static Limbs CombineDigits(const Limbs& first, long long first_coef,
+                             const Limbs& second, long long second_coef) {
+    Limbs result(first.size(), 0);
+    long long carry = 0;
+
+    for (size_t i = 0; i < first.size(); ++i) {
+      long long current = first[i] * first_coef + (i < second.size() ? second[i] * second_coef : 0) + carry;
+      carry = current / kBase;
+      current %= kBase;
+      if (current < 0) {
+        current += kBase;
+        --carry;
+      }
+      result[i] = current;
+    }
+
+    TrimDigits(result);
+    return result;
+  }
+
+  // Lehmer's gcd: runs Euclid on 31-bit approximations of the leading limbs
+  // while the quotients provably match the exact ones, then applies the
+  // collected cofactors to the full numbers in one linear pass.
+  static Limbs GcdDigits(Limbs first, Limbs second) {
+    TrimDigits(first);
+    TrimDigits(second);
+    if (CompareDigits(first, second) < 0) {
+      std::swap(first, second);
+    }
+
+    while (second.size() > 1) {
+      size_t size = first.size();
+      long long first_lead = first[size - 1] * kBase + first[size - 2];
+      long long second_lead = (second.size() == size ? second[size - 1] * kBase : 0) +
+                              (second.size() >= size - 1 ? second[size - 2] : 0);
+      long long scale = first_lead / (1ll << 31) + 1;
+      long long x = first_lead / scale;
+      long long y = second_lead / scale;
+      long long a = 1;
+      long long b = 0;
+      long long c = 0;
+      long long d = 1;
+
+      while (y + c != 0 && y + d != 0) {
+        long long quotient = (x + a) / (y + c);
+        if (quotient != (x + b) / (y + d)) {
+          break;
+        }
+
+        long long next = a - quotient * c;
+        a = c;
+        c = next;
+        next = b - quotient * d;
+        b = d;
+        d = next;
+        next = x - quotient * y;
+        x = y;
+        y = next;
+      }
+
+      if (b == 0) {
+        Limbs quotient;
+        Limbs remainder;
+        DivModDigits(first, second, quotient, remainder);
+        first = std::move(second);
+        second = std::move(remainder);
+      } else {
+        Limbs new_first = CombineDigits(first, a, second, b);
+        second = CombineDigits(first, c, second, d);
+        first = std::move(new_first);
+      }
+    }
+
+    if (second.empty()) {
+      return first;
+    }
+
+    return {(long long)BinaryGcd(DivideDigitsBySmall(first, second[0]), second[0])};
+  }
+
+  // Stein's gcd on words: countr_zero strips the factors of two in one
+  // instruction, so the loop has no divisions at all.
+  static unsigned long long BinaryGcd(unsigned long long first, unsigned long long second) {
+    if (first == 0 || second == 0) {
+      return first | second;
+    }
+
+    int shift = std::countr_zero(first | second);
+    first >>= std::countr_zero(first);
+    while (second != 0) {
+      second >>= std::countr_zero(second);
+      if (first > second) {
+        std::swap(first, second);
+      }
+      second -= first;
+    }
+    return first << shift;
+  }
+
+  // Succeeds if the magnitude is at most INT64_MAX, so that the value can be
+  // negated and multiplied in __int128 without overflow.
+  bool ReadSmall(long long& value) const {
+    if (digits_.size() > 3) {
+      return false;
+    }
+
+    unsigned __int128 magnitude = 0;
+    for (int i = (int)digits_.size() - 1; i >= 0; --i) {
+      magnitude = magnitude * kBase + digits_[i];
+    }
+    if (magnitude > INT64_MAX) {
+      return false;
+    }
+    value = sign_ == negative ? -(long long)magnitude : (long long)magnitude;
+    return true;
+  }
+
+  void AssignWide(__int128 value) {
+    unsigned __int128 magnitude = value < 0 ? -(unsigned __int128)value : value;
+    digits_.clear();
+    while (magnitude > UINT64_MAX) {
+      digits_.push_back((long long)(magnitude % kBase));
+      magnitude /= kBase;
+    }
+    BuildFromUll((unsigned long long)magnitude);
+    sign_ = value < 0 ? negative : positive;
+    NormalizeDigits();
+  }
+
+  // value^-1 modulo kBase^size by Newton-Hensel lifting, which doubles the
+  // number of correct limbs per step; value must be coprime with kBase.
+  static Limbs InverseModBasePower(const Limbs& value, size_t size) {
+    long long old_remainder = value[0];
+    long long remainder = kBase;
+    long long old_coef = 1;
+    long long coef = 0;
+    while (remainder != 0) {
+      long long quotient = old_remainder / remainder;
+      std::swap(old_remainder, remainder);
+      remainder -= quotient * old_remainder;
+      std::swap(old_coef, coef);
+      coef -= quotient * old_coef;
+    }
+
+    Limbs inverse = {(old_coef % kBase + kBase) % kBase};
+    for (size_t precision = 1; precision < size;) {
+      precision = std::min(2 * precision, size);
+      Limbs product = SliceDigits(MultiplyDigits(SliceDigits(value, 0, precision), inverse),
+                                  0, precision);
+      Limbs correction(precision + 1, 0);
+      correction[precision] = 1;
+      AddDigitsTo(correction, {2});
+      SubtractDigitsFrom(correction, product);
+      inverse = SliceDigits(MultiplyDigits(inverse, SliceDigits(correction, 0, precision)),
+                            0, precision);
+    }
+
+    return inverse;
+  }
+
+  // |base|^exponent by left-to-right square and multiply. The result is
+  // reserved once from bit_length(base) * exponent, and every step writes
+  // into the other of two buffers of that size, so the steps below the
+  // Karatsuba threshold never allocate. Multiplying by base rather than by
+  // precomputed odd powers keeps the second factor as short as it gets.
+  static Limbs PowerDigits(const Limbs& base, unsigned long long exponent) {
+    if (exponent == 0) {
+      return {1};
+    }
+    if (base.back() == 0) {
+      return {};
+    }
+
+    size_t size = (size_t)(Log2Digits(base) * (double)exponent / std::log2((double)kBase)) + 2;
+    Limbs result;
+    Limbs scratch;
+    result.reserve(size);
+    scratch.reserve(size);
+    result = base;
+
+    int top_bit = 63;
+    while ((exponent >> top_bit) == 0) {
+      --top_bit;
+    }
+    for (int bit = top_bit - 1; bit >= 0; --bit) {
+      MultiplyDigitsInto(result, result, scratch);
+      std::swap(result, scratch);
+      if ((exponent >> bit) & 1) {
+        MultiplyDigitsInto(result, base, scratch);
+        std::swap(result, scratch);
+      }
+    }
+
+    return result;
+  }
+
+  static BigInteger Power(const BigInteger& base, unsigned long long exponent) {
+    BigInteger result = FromDigits(PowerDigits(base.digits_, exponent));
+    if (base.sign_ == negative && exponent % 2 == 1) {
+      result.sign_ = negative;
+    }
+    return result;
+  }
+
+  // Positive estimate of value^(1 / degree) good to about 50 bits.
+  static BigInteger RootEstimate(const BigInteger& value, unsigned long long degree) {
+    double root_bits = Log2Digits(value.digits_) / degree;
+    if (root_bits < 60) {
+      return BigInteger((unsigned long long)std::exp2(root_bits) + 1);
+    }
+
+    int shift = (int)root_bits - 52;
+    BigInteger estimate((unsigned long long)std::exp2(root_bits - shift) + 1);
+    estimate *= Power(2, shift);
+    return estimate;
+  }
+
+  // One Newton step towards value^(1 / degree). From any positive root it
+  // lands at or above floor(value^(1 / degree)), and from above it decreases.
+  static BigInteger NewtonStep(const BigInteger& value, unsigned long long degree,
+                               const BigInteger& root) {
+    BigInteger next = root;
+    next *= BigInteger(degree - 1);
+    BigInteger quotient = value;
+    quotient /= Power(root, degree - 1);
+    next += quotient;
+    next /= BigInteger(degree);
+    return next;
+  }
+
+  // floor(value^(1 / degree)) for positive values. The root of the top limbs,
+  // scaled back and rounded up, is close enough that one full-size Newton
+  // step leaves it at most slightly too large, so the cost is about one
+  // division and two powers at full size. Short roots iterate from a double
+  // estimate instead, and a degree beyond the bit length of value gives 1
+  // without any arithmetic.
+  static BigInteger Root(const BigInteger& value, unsigned long long degree) {
+    if (Log2Digits(value.digits_) + 1 < (double)degree) {
+      return 1;
+    }
+
+    size_t root_limbs = (value.digits_.size() - 1) / degree;
+    size_t dropped = root_limbs >= 3 ? (root_limbs - 1) / 2 : 0;
+
+    if (dropped == 0) {
+      BigInteger root = NewtonStep(value, degree, RootEstimate(value, degree));
+      for (BigInteger next = NewtonStep(value, degree, root); CompareDigits(next.digits_, root.digits_) < 0;
+           next = NewtonStep(value, degree, root)) {
+        root = std::move(next);
+      }
+      return root;
+    }
+
+    BigInteger root = Root(FromDigits(SliceDigits(value.digits_, degree * dropped, value.digits_.size())),
+                           degree);
+    root += 1;
+    root.digits_ = ShiftDigits(root.digits_, dropped);
+    root = NewtonStep(value, degree, root);
+    while (CompareDigits(Power(root, degree).digits_, value.digits_) > 0) {
+      root = NewtonStep(value, degree, root);
+    }
+    return root;
+  }
+
+  // log2 |value| from the top limbs, accurate far beyond what a double needs.
+  static double Log2Digits(const Limbs& digits) {
+    double top = 0;
+    size_t used = std::min<size_t>(digits.size(), 3);
+    for (size_t i = digits.size() - used; i < digits.size(); ++i) {
+      top = top / kBase + digits[i];
+    }
+    return std::log2(top) + (digits.size() - 1) * std::log2((double)kBase);
+  }
+
+  // Left-to-right sliding-window exponentiation; multiply(x, y) is the
+  // modular product in whatever representation T the caller works in.
+  template <typename T, typename Multiply>
+  static T SlidingWindowPower(const T& base, const T& one, const BigInteger& exponent,
+                              Multiply multiply) {
+    Limbs bits = kBase == (1 << kBaseBits) ? exponent.digits_
+                                           : ConvertRadix(exponent.digits_, kBase, 1 << kBaseBits);
+    TrimDigits(bits);
+    if (bits.empty()) {
+      return one;
+    }
+
+    auto bit = [&bits](long long index) {
+      return (bits[index / kBaseBits] >> (index % kBaseBits)) & 1;
+    };
+    long long bit_count = (long long)(bits.size() - 1) * kBaseBits;
+    for (long long top = bits.back(); top != 0; top >>= 1) {
+      ++bit_count;
+    }
+
+    int window = bit_count <= 8 ? 1 : bit_count <= 64 ? 3 : bit_count <= 256 ? 4 : bit_count <= 1024 ? 5 : 6;
+    std::vector<T> odd_powers(1 << (window - 1), base);
+    if (window > 1) {
+      T base_square = multiply(base, base);
+      for (size_t i = 1; i < odd_powers.size(); ++i) {
+        odd_powers[i] = multiply(odd_powers[i - 1], base_square);
+      }
+    }
+
+    T result = one;
+    bool started = false;
+    for (long long index = bit_count - 1; index >= 0;) {
+      if (bit(index) == 0) {
+        result = multiply(result, result);
+        --index;
+        continue;
+      }
+
+      long long low = std::max(index - window + 1, 0ll);
+      while (bit(low) == 0) {
+        ++low;
+      }
+
+      long long value = 0;
+      for (long long i = index; i >= low; --i) {
+        value = 2 * value + bit(i);
+        if (started) {
+          result = multiply(result, result);
+        }
+      }
+
+      result = started ? multiply(result, odd_powers[value / 2]) : odd_powers[value / 2];
+      started = true;
+      index = low - 1;
+    }
+
+    return result;
+  }
+
+  // kDecimalBase^(2^level) in limbs. Conversions on several threads share
+  // the cache, so it grows under a lock; a deque keeps references to cached
+  // powers valid while higher levels are appended.
+  static const Limbs& DecimalPower(size_t level) {
+    static std::mutex mutex;
+    static std::deque<Limbs> powers;
+    std::lock_guard<std::mutex> lock(mutex);
+    BigIntegerArena::HeapScope heap;
+
+    if (powers.empty()) {
+      powers.push_back(FromDecimalChunks({0, 1}));
+    }
+    while (powers.size() <= level) {
+      powers.push_back(MultiplyDigits(powers.back(), powers.back()));
+    }
+
+    return powers[level];
+  }
+
+  static long long ParseChunk(const char* first, const char* last) {
+    long long chunk = 0;
+
+    for (; first != last; ++first) {
+      chunk = chunk * 10 + (*first - '0');
+    }
+
+    return chunk;
+  }
+
+  // Converts chunks[begin, end) of a base-1e9 number: splits off the lowest
+  // 2^k chunks, converts both halves recursively and joins them with one
+  // multiplication by a cached power.
+  static Limbs ConvertDecimalChunks(const Limbs& chunks, size_t begin, size_t end) {
+    if (end - begin <= kRadixConversionThreshold) {
+      Limbs result = FromDecimalChunks(SliceDigits(chunks, begin, end));
+      TrimDigits(result);
+      return result;
+    }
+
+    size_t level = 0;
+    while ((size_t)1 << (level + 1) < end - begin) {
+      ++level;
+    }
+    size_t low_end = begin + ((size_t)1 << level);
+
+    Limbs result = MultiplyDigits(ConvertDecimalChunks(chunks, low_end, end), DecimalPower(level));
+    AddDigitsTo(result, ConvertDecimalChunks(chunks, begin, low_end));
+    TrimDigits(result);
+    return result;
+  }
+
+  static Limbs DecimalChunksToDigits(Limbs chunks) {
+    TrimDigits(chunks);
+    if (kBase == kDecimalBase) {
+      return chunks;
+    }
+    return ConvertDecimalChunks(chunks, 0, chunks.size());
+  }
+
+  static Limbs ParseDecimal(const char* first, const char* last) {
+    size_t length = last - first;
+    Limbs chunks;
+    chunks.reserve(length / kDecimalBaseLength + 1);
+    for (size_t end = length; end > 0; end -= std::min<size_t>(end, kDecimalBaseLength)) {
+      chunks.push_back(ParseChunk(first + end - std::min<size_t>(end, kDecimalBaseLength),
+                                  first + end));
+    }
+
+    return DecimalChunksToDigits(std::move(chunks));
+  }
+
+  // Writes base-1e9 chunks; with width == 0 the leading zeros are dropped,
+  // otherwise exactly width characters are produced.
+  static char* WriteChunks(const Limbs& chunks, size_t width, char* first, char* last) {
+    size_t top = chunks.size();
+    while (top > 0 && chunks[top - 1] == 0) {
+      --top;
+    }
+
+    if (width == 0) {
+      long long top_chunk = top == 0 ? 0 : chunks[top - 1];
+      width = (top == 0 ? 0 : top - 1) * kDecimalBaseLength + 1;
+      for (long long rest = top_chunk / 10; rest != 0; rest /= 10) {
+        ++width;
+      }
+    }
+
+    if ((size_t)(last - first) < width) {
+      return nullptr;
+    }
+
+    long long chunk = 0;
+    for (size_t i = 0; i < width; ++i) {
+      if (i % kDecimalBaseLength == 0) {
+        chunk = i / kDecimalBaseLength < top ? chunks[i / kDecimalBaseLength] : 0;
+      }
+      first[width - 1 - i] = char('0' + chunk % 10);
+      chunk /= 10;
+    }
+
+    return first + width;
+  }
+
+  static char* WriteDecimal(const Limbs& digits, size_t width, char* first, char* last) {
+    if (kBase == kDecimalBase) {
+      return WriteChunks(digits, width, first, last);
+    }
+
+    if (digits.size() <= kRadixConversionThreshold) {
+      return WriteChunks(ConvertRadix(digits, kBase, kDecimalBase), width, first, last);
+    }
+
+    size_t level = 0;
+    if (width == 0) {
+      while (2 * DecimalPower(level + 1).size() <= digits.size()) {
+        ++level;
+      }
+    } else {
+      level = 0;
+      while ((size_t)kDecimalBaseLength << (level + 1) < width) {
+        ++level;
+      }
+    }
+    size_t low_width = (size_t)kDecimalBaseLength << level;
+
+    Limbs high;
+    Limbs low;
+    DivModDigits(digits, DecimalPower(level), high, low);
+
+    if (width != 0 || !high.empty()) {
+      first = WriteDecimal(high, width == 0 ? 0 : width - low_width, first, last);
+      if (first == nullptr) {
+        return nullptr;
+      }
+    }
+
+    return WriteDecimal(low, (high.empty() && width == 0) ? 0 : low_width, first, last);
+  }
+
+  static size_t VarintSize(unsigned long long value) {
+    size_t size = 1;
+    for (; value >= 0x80; value >>= 7) {
+      ++size;
+    }
+    return size;
+  }
+
+  static char* WriteVarint(char* output, unsigned long long value) {
+    for (; value >= 0x80; value >>= 7) {
+      *output++ = char((value & 0x7F) | 0x80);
+    }
+    *output++ = char(value);
+    return output;
+  }
+
+  // Returns nullptr if the input ends early or the value does not fit.
+  static const char* ReadVarint(const char* first, const char* last, unsigned long long& value) {
+    value = 0;
+    for (int shift = 0; first != last && shift < 64; shift += 7) {
+      unsigned char byte = *first++;
+      if (shift == 63 && byte > 1) {
+        return nullptr;
+      }
+      value |= (unsigned long long)(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return first;
+      }
+    }
+    return nullptr;
+  }
+
+  static void WriteLimb(char* output, long long limb) {
+    for (int i = 0; i < 4; ++i) {
+      output[i] = char(limb >> (8 * i));
+    }
+  }
+
+  static long long ReadLimb(const char* input) {
+    long long limb = 0;
+    for (int i = 0; i < 4; ++i) {
+      limb |= (long long)(unsigned char)input[i] << (8 * i);
+    }
+    return limb;
+  }
+
+  // Values below kBase^2 fit in 60 bits and are stored as a single varint.
+  bool HasSmallLayout() const {
+    return digits_.size() <= 2;
+  }
+
+  // Tag byte and varint header; for the small layout that is everything.
+  char* WriteBinaryHeader(char* output) const {
+    unsigned long long header = 0;
+    BinaryLayout layout = kBase == kDecimalBase ? decimal_limbs_layout : binary_limbs_layout;
+
+    if (HasSmallLayout()) {
+      layout = small_layout;
+      for (int i = (int)digits_.size() - 1; i >= 0; --i) {
+        header = header * kBase + digits_[i];
+      }
+    } else {
+      header = digits_.size();
+    }
+
+    *output++ = char(kBinaryFormatVersion << 4 | layout);
+    return WriteVarint(output, header << 1 | (sign_ == negative ? 1 : 0));
+  }
+
+  static long long LayoutRadix(BinaryLayout layout) {
+    return layout == decimal_limbs_layout ? kDecimalBase : 1ll << kBaseBits;
+  }
+
+ public:
+  BigInteger operator- () const& {
+    BigInteger result = *this;
+    return -std::move(result);
+  }
+
+  BigInteger operator- () && {
+    if (*this) {
+      sign_ = !sign_;
+      ForgetHash();
+    }
+
+    return std::move(*this);
+  }
+
+  BigInteger& operator+= (const BigInteger& second_num) {
+    AddSigned(second_num.digits_, second_num.sign_);
+    return *this;
+  }
+
+  BigInteger& operator-= (const BigInteger& second_num) {
+    AddSigned(second_num.digits_, !second_num.sign_);
+    return *this;
+  }
+
+  BigInteger& operator*= (const BigInteger& second_num) {
+    sign_ = sign_ * second_num.sign_;
+    digits_ = MultiplyDigits(digits_, second_num.digits_);
+    NormalizeDigits();
+
+    return *this;
+  }
+
+  BigInteger& operator/= (const BigInteger& second_num) {
+    Limbs quotient;
+    Limbs remainder;
+    DivModDigits(digits_, second_num.digits_, quotient, remainder);
+
+    digits_ = std::move(quotient);
+    sign_ = sign_ * second_num.sign_;
+    NormalizeDigits();
+
+    return *this;
+  }
+
+  BigInteger& operator%= (const BigInteger& second_num) {
+    Limbs quotient;
+    Limbs remainder;
+    DivModDigits(digits_, second_num.digits_, quotient, remainder);
+
+    digits_ = std::move(remainder);
+    NormalizeDigits();
+
+    return *this;
+  }
+
+  BigInteger operator++ (int) {
+    BigInteger temp = *this;
+    *this += 1;
+    return temp;
+  }
+
+  BigInteger operator-- (int) {
+    BigInteger temp = *this;
+    *this -= 1;
+    return temp;
+  }
+
+  BigInteger& operator++ () {
+    return *this += 1;
+  }
+
+  BigInteger& operator-- () {
+    return *this -= 1;
+  }
+
+  BigInteger& operator= (const BigInteger& num) = default;
+
+  BigInteger& operator= (BigInteger&& num) = default;
+
+  size_t DecimalLengthBound() const {
+    size_t digit_count = kBase == kDecimalBase ? digits_.size() * kDecimalBaseLength
+                                               : digits_.size() * kBaseBits * 30103 / 100000 + 1;
+    return digit_count + 1;
+  }
+
+  std::to_chars_result ToChars(char* first, char* last) const {
+    if (sign_ == negative) {
+      if (first == last) {
+        return {last, std::errc::value_too_large};
+      }
+      *first++ = '-';
+    }
+
+    char* end = WriteDecimal(digits_, 0, first, last);
+    if (end == nullptr) {
+      return {last, std::errc::value_too_large};
+    }
+
+    return {end, std::errc{}};
+  }
+
+  // Unlike std::from_chars, a leading '+' is accepted, as the string
+  // constructor always has.
+  static std::from_chars_result FromChars(const char* first, const char* last, BigInteger& value) {
+    const char* begin = first;
+    bool is_negative = begin != last && *begin == '-';
+    if (begin != last && (*begin == '-' || *begin == '+')) {
+      ++begin;
+    }
+
+    const char* end = begin;
+    while (end != last && '0' <= *end && *end <= '9') {
+      ++end;
+    }
+
+    if (end == begin) {
+      return {first, std::errc::invalid_argument};
+    }
+
+    value.digits_ = ParseDecimal(begin, end);
+    value.sign_ = is_negative ? negative : positive;
+    value.NormalizeDigits();
+    return {end, std::errc{}};
+  }
+
+  // Reads an optional sign and a run of digits straight from the stream buffer,
+  // nine digits to a chunk; no token string is built. Stops before the first
+  // non-digit and sets failbit if there was no digit. length_hint, the
+  // expected number of digits, only sizes the chunk buffer up front.
+  static std::istream& ReadDecimal(std::istream& input, BigInteger& value, size_t length_hint = 0) {
+    std::istream::sentry sentry(input);
+    if (!sentry) {
+      return input;
+    }
+
+    std::streambuf* buffer = input.rdbuf();
+    int current = buffer->sgetc();
+    bool is_negative = current == '-';
+    if (current == '-' || current == '+') {
+      current = buffer->snextc();
+    }
+
+    Limbs chunks;
+    chunks.reserve(length_hint / kDecimalBaseLength + 1);
+    long long chunk = 0;
+    int chunk_length = 0;
+    bool has_digits = false;
+    for (; '0' <= current && current <= '9'; current = buffer->snextc()) {
+      chunk = chunk * 10 + (current - '0');
+      has_digits = true;
+      if (++chunk_length == kDecimalBaseLength) {
+        chunks.push_back(chunk);
+        chunk = 0;
+        chunk_length = 0;
+      }
+    }
+
+    if (current == std::char_traits<char>::eof()) {
+      input.setstate(std::ios::eofbit);
+    }
+    if (!has_digits) {
+      input.setstate(std::ios::failbit);
+      return input;
+    }
+
+    // The chunks were cut from the front; shifting by the length of the last,
+    // partial one lines them up with powers of 1e9 counted from the back.
+    std::reverse(chunks.begin(), chunks.end());
+    long long scale = 1;
+    for (int i = 0; i < chunk_length; ++i) {
+      scale *= 10;
+    }
+    long long carry = chunk;
+    for (long long& limb : chunks) {
+      long long product = limb * scale + carry;
+      limb = product % kDecimalBase;
+      carry = product / kDecimalBase;
+    }
+    if (carry != 0) {
+      chunks.push_back(carry);
+    }
+
+    value.digits_ = DecimalChunksToDigits(std::move(chunks));
+    value.sign_ = is_negative ? negative : positive;
+    value.NormalizeDigits();
+    return input;
+  }
+
+  // Binary encoding, little-endian throughout: a tag byte with
+  // kBinaryFormatVersion in the high nibble and the BinaryLayout in the low
+  // one, then
+  //   small_layout:       varint(|value| << 1 | is_negative)
+  //   *_limbs_layout:     varint(limb count << 1 | is_negative), 4 bytes per limb
+  // Limbs are written in the build's own radix, so reading them back into a
+  // build with the same radix is a plain copy.
+  size_t SerializedSize() const {
+    if (HasSmallLayout()) {
+      char header[16];
+      return WriteBinaryHeader(header) - header;
+    }
+    return 1 + VarintSize(digits_.size() << 1 | 1) + 4 * digits_.size();
+  }
+
+  std::to_chars_result Serialize(char* first, char* last) const {
+    if ((size_t)(last - first) < SerializedSize()) {
+      return {last, std::errc::value_too_large};
+    }
+
+    first = WriteBinaryHeader(first);
+    if (!HasSmallLayout()) {
+      for (long long limb : digits_) {
+        WriteLimb(first, limb);
+        first += 4;
+      }
+    }
+    return {first, std::errc{}};
+  }
+
+  // Decodes straight into the limb storage value already owns, so reading
+  // into a preallocated BigInteger does not allocate. value is left unchanged
+  // on failure. Limbs written by a build with the other radix are accepted
+  // and converted.
+  static std::from_chars_result Deserialize(const char* first, const char* last, BigInteger& value) {
+    std::from_chars_result failure{first, std::errc::invalid_argument};
+    if (first == last || (unsigned char)*first >> 4 != kBinaryFormatVersion ||
+        (*first & 0xF) > binary_limbs_layout) {
+      return failure;
+    }
+
+    BinaryLayout layout = BinaryLayout(*first & 0xF);
+    unsigned long long header = 0;
+    const char* current = ReadVarint(first + 1, last, header);
+    if (current == nullptr) {
+      return failure;
+    }
+
+    if (layout == small_layout) {
+      value.digits_.clear();
+      value.BuildFromUll(header >> 1);
+    } else {
+      unsigned long long count = header >> 1;
+      long long radix = LayoutRadix(layout);
+      if ((unsigned long long)(last - current) / 4 < count) {
+        return failure;
+      }
+      for (unsigned long long i = 0; i < count; ++i) {
+        if (ReadLimb(current + 4 * i) >= radix) {
+          return failure;
+        }
+      }
+
+      value.digits_.clear();
+      value.digits_.resize(count);
+      for (unsigned long long i = 0; i < count; ++i, current += 4) {
+        value.digits_[i] = ReadLimb(current);
+      }
+      if (radix != kBase) {
+        value.digits_ = ConvertRadix(value.digits_, radix, kBase);
+      }
+    }
+
+    value.sign_ = header & 1 ? negative : positive;
+    value.NormalizeDigits();
+    return {current, std::errc{}};
+  }
+
+  void WriteBinary(std::ostream& output) const {
+    char buffer[4096];
+    output.write(buffer, WriteBinaryHeader(buffer) - buffer);
+
+    if (!HasSmallLayout()) {
+      for (size_t begin = 0; begin < digits_.size(); begin += sizeof(buffer) / 4) {
+        size_t end = std::min(digits_.size(), begin + sizeof(buffer) / 4);
+        for (size_t i = begin; i < end; ++i) {
+          WriteLimb(buffer + 4 * (i - begin), digits_[i]);
+        }
+        output.write(buffer, 4 * (end - begin));
+      }
+    }
+  }
+
+  // Sets failbit and leaves value zero if the input is not a valid encoding.
+  static std::istream& ReadBinary(std::istream& input, BigInteger& value) {
+    char buffer[4096];
+    size_t header_size = 0;
+    while (header_size < 11 && input.get(buffer[header_size])) {
+      ++header_size;
+      if (header_size > 1 && (buffer[header_size - 1] & 0x80) == 0) {
+        break;
+      }
+    }
+
+    unsigned long long header = 0;
+    if (!input || (unsigned char)buffer[0] >> 4 != kBinaryFormatVersion ||
+        (buffer[0] & 0xF) > binary_limbs_layout ||
+        ReadVarint(buffer + 1, buffer + header_size, header) == nullptr) {
+      value = 0;
+      input.setstate(std::ios::failbit);
+      return input;
+    }
+
+    BinaryLayout layout = BinaryLayout(buffer[0] & 0xF);
+
+    if (layout == small_layout) {
+      Deserialize(buffer, buffer + header_size, value);
+      return input;
+    }
+
+    size_t count = header >> 1;
+    long long radix = LayoutRadix(layout);
+    value.digits_.clear();
+    for (size_t begin = 0; begin < count; begin += sizeof(buffer) / 4) {
+      size_t end = std::min(count, begin + sizeof(buffer) / 4);
+      bool valid = (bool)input.read(buffer, 4 * (end - begin));
+      for (size_t i = begin; valid && i < end; ++i) {
+        long long limb = ReadLimb(buffer + 4 * (i - begin));
+        valid = limb < radix;
+        value.digits_.push_back(limb);
+      }
+
+      if (!valid) {
+        value = 0;
+        input.setstate(std::ios::failbit);
+        return input;
+      }
+    }
+    if (radix != kBase) {
+      value.digits_ = ConvertRadix(value.digits_, radix, kBase);
+    }
+    value.sign_ = header & 1 ? negative : positive;
+    value.NormalizeDigits();
+    return input;
+  }
+
+  std::string toString() const {
+    std::string result(DecimalLengthBound(), '\0');
+    std::to_chars_result written = ToChars(result.data(), result.data() + result.size());
+    result.resize(written.ptr - result.data());
+    return result;
+  }
+
+  BigInteger() {}
+
+  BigInteger(int num) {
+    sign_ = (num < 0) ? negative : positive;
+
+    if (num == 0) {
+      digits_.push_back(0);
+    }
+
+    BuildFromUll((unsigned long long)std::abs(num));
+  }
+
+  explicit BigInteger(unsigned long long num) {
+    BuildFromUll(num);
+  }
+
+  BigInteger(const BigInteger& num) = default;
+
+  BigInteger(BigInteger&& num) = default;
+
+  BigInteger(const std::string& string) {
+    const char* end = string.data() + string.size();
+    std::from_chars_result parsed = FromChars(string.data(), end, *this);
+
+    if (parsed.ec != std::errc{} || parsed.ptr != end) {
+      throw std::invalid_argument("BigInteger: not a decimal integer");
+    }
+  }
+
+  explicit operator bool() const {
+    return digits_.size() != 1 || digits_[0] != 0;
+  }
+
+  // Hashes the limbs directly, with every limb bit reaching the low bits
+  // that a table reduces modulo its bucket count. Equal values hash equally
+  // within one build; the two radices give different hashes.
+  size_t Hash() const {
+#ifdef BIGINTEGER_CACHE_HASH
+    size_t hash = hash_.Load();
+    return hash != 0 ? hash : hash_.Store(ComputeHash());
+#else
+    return ComputeHash();
+#endif
+  }
+
+  friend bool operator== (const BigInteger& first_num, const BigInteger& second_num);
+  friend bool operator< (const BigInteger& first_num, const BigInteger& second_num);
+  friend bool operator<= (const BigInteger& first_num, const BigInteger& second_num);
+
+  friend BigInteger Gcd(BigInteger num1, BigInteger num2);
+  friend void DivMod(const BigInteger& dividend, const BigInteger& divisor,
+                     BigInteger& quotient, BigInteger& remainder);
+  friend BigInteger Pow(const BigInteger& base, unsigned long long exponent);
+  friend BigInteger ISqrt(const BigInteger& value);
+  friend BigInteger IRoot(const BigInteger& value, unsigned long long degree);
+
+  friend class BigIntegerReciprocal;
+  friend class MontgomeryContext;
+  friend class BarrettContext;
+  friend class Rational;
+
+  template <size_t Bits>
+  friend class FixedBigInteger;
+
+  template <char... Chars>
+  friend BigInteger operator"" _bi();
+
+  template <size_t TermCount>
+  friend class BigIntegerSum;
+};
+
+// Expression templates for sums of products: a * b - c * d + e collects
+// references to the operands in a BigIntegerSum<3>, and nothing is computed
+// until it is converted to a BigInteger, when EvaluateFused builds every
+// term into the one result buffer. The references are not extended, so an
+// expression has to be consumed within the full-expression that made it.
+// Rational builds these explicitly. Defining BIGINTEGER_EXPRESSION_TEMPLATES
+// also makes the product of two BigInteger lvalues a BigIntegerProduct.
+template <size_t TermCount>
+class BigIntegerSum {
+ private:
+  std::array<FusedTerm, TermCount> terms_;
+
+ public:
+  explicit BigIntegerSum(const std::array<FusedTerm, TermCount>& terms) : terms_(terms) {}
+
+  BigIntegerSum(const BigInteger& first, const BigInteger& second) requires (TermCount == 1)
+      : terms_{{{&first, &second, false}}} {}
+
+  // Not copyable, so that an expression is not carried away from its
+  // operands by accident, e.g. through BigIntegerArena::Export.
+  BigIntegerSum(const BigIntegerSum&) = delete;
+  BigIntegerSum& operator=(const BigIntegerSum&) = delete;
+
+  const std::array<FusedTerm, TermCount>& terms() const {
+    return terms_;
+  }
+
+  template <size_t OtherCount>
+  BigIntegerSum<TermCount + OtherCount> Append(const std::array<FusedTerm, OtherCount>& other,
+                                               bool negated) const {
+    std::array<FusedTerm, TermCount + OtherCount> terms;
+    std::copy(terms_.begin(), terms_.end(), terms.begin());
+    for (size_t i = 0; i < OtherCount; ++i) {
+      terms[TermCount + i] = other[i];
+      terms[TermCount + i].negated ^= negated;
+    }
+    return BigIntegerSum<TermCount + OtherCount>(terms);
+  }
+
+  void EvaluateInto(BigInteger& destination) const {
+    BigInteger::EvaluateFused(terms_.data(), TermCount, destination);
+  }
+
+  operator BigInteger() const {
+    BigInteger result;
+    EvaluateInto(result);
+    return result;
+  }
+
+  std::string toString() const {
+    return BigInteger(*this).toString();
+  }
+};
+
+using BigIntegerProduct = BigIntegerSum<1>;
+
+template <size_t FirstCount, size_t SecondCount>
+BigIntegerSum<FirstCount + SecondCount> operator+ (const BigIntegerSum<FirstCount>& first,
+                                                   const BigIntegerSum<SecondCount>& second) {
+  return first.Append(second.terms(), false);
+}
+
+template <size_t FirstCount, size_t SecondCount>
+BigIntegerSum<FirstCount + SecondCount> operator- (const BigIntegerSum<FirstCount>& first,
+                                                   const BigIntegerSum<SecondCount>& second) {
+  return first.Append(second.terms(), true);
+}
+
+// A plain BigInteger operand has to match exactly, so that integers of other
+// types take the eager operators instead, and it is taken by forwarding
+// reference so that a temporary is not a worse match here than for those.
+template <typename Num>
+concept BigIntegerOperand = std::is_same_v<std::remove_cvref_t<Num>, BigInteger>;
+
+template <size_t TermCount, BigIntegerOperand Num>
+BigIntegerSum<TermCount + 1> operator+ (const BigIntegerSum<TermCount>& sum, Num&& num) {
+  return sum.Append(std::array<FusedTerm, 1>{{{&num, nullptr, false}}}, false);
+}
+
+template <size_t TermCount, BigIntegerOperand Num>
+BigIntegerSum<TermCount + 1> operator- (const BigIntegerSum<TermCount>& sum, Num&& num) {
+  return sum.Append(std::array<FusedTerm, 1>{{{&num, nullptr, false}}}, true);
+}
+
+template <size_t TermCount, BigIntegerOperand Num>
+BigIntegerSum<TermCount + 1> operator+ (Num&& num, const BigIntegerSum<TermCount>& sum) {
+  return BigIntegerSum<1>(std::array<FusedTerm, 1>{{{&num, nullptr, false}}}).Append(sum.terms(), false);
+}
+
+template <size_t TermCount, BigIntegerOperand Num>
+BigIntegerSum<TermCount + 1> operator- (Num&& num, const BigIntegerSum<TermCount>& sum) {
+  return BigIntegerSum<1>(std::array<FusedTerm, 1>{{{&num, nullptr, false}}}).Append(sum.terms(), true);
+}
+
+BigInteger operator+ (const BigInteger& num1, const BigInteger& num2) {
+  BigInteger result = num1;
+  result += num2;
+  return result;
+}
+
+BigInteger operator+ (BigInteger&& num1, const BigInteger& num2) {
+  num1 += num2;
+  return std::move(num1);
+}
+
+BigInteger operator+ (const BigInteger& num1, BigInteger&& num2) {
+  num2 += num1;
+  return std::move(num2);
+}
+
+BigInteger operator+ (BigInteger&& num1, BigInteger&& num2) {
+  num1 += num2;
+  return std::move(num1);
+}
+
+BigInteger operator- (const BigInteger& num1, const BigInteger& num2) {
+  BigInteger result = num1;
+  result -= num2;
+  return result;
+}
+
+BigInteger operator- (BigInteger&& num1, const BigInteger& num2) {
+  num1 -= num2;
+  return std::move(num1);
+}
+
+BigInteger operator- (const BigInteger& num1, BigInteger&& num2) {
+  num2 -= num1;
+  return -std::move(num2);
+}
+
+BigInteger operator- (BigInteger&& num1, BigInteger&& num2) {
+  num1 -= num2;
+  return std::move(num1);
+}
+
+#ifdef BIGINTEGER_EXPRESSION_TEMPLATES
+BigIntegerProduct operator* (const BigInteger& num1, const BigInteger& num2) {
+  return BigIntegerProduct(num1, num2);
+}
+#else
+BigInteger operator* (const BigInteger& num1, const BigInteger& num2) {
+  BigInteger result = num1;
+  result *= num2;
+  return result;
+}
+#endif
+
+BigInteger operator* (BigInteger&& num1, const BigInteger& num2) {
+  num1 *= num2;
+  return std::move(num1);
+}
+
+BigInteger operator* (const BigInteger& num1, BigInteger&& num2) {
+  num2 *= num1;
+  return std::move(num2);
+}
+
+BigInteger operator* (BigInteger&& num1, BigInteger&& num2) {
+  num1 *= num2;
+  return std::move(num1);
+}
+
+BigInteger operator/ (const BigInteger& num1, const BigInteger& num2) {
+  BigInteger result = num1;
+  result /= num2;
+  return result;
+}
+
+BigInteger operator/ (BigInteger&& num1, const BigInteger& num2) {
+  num1 /= num2;
+  return std::move(num1);
+}
+
+BigInteger operator% (const BigInteger& num1, const BigInteger& num2) {
+  BigInteger result = num1;
+  result %= num2;
+  return result;
+}
+
+BigInteger operator% (BigInteger&& num1, const BigInteger& num2) {
+  num1 %= num2;
+  return std::move(num1);
+}
+
+// dividend / divisor and dividend % divisor from a single division. The
+// outputs may alias the inputs.
+void DivMod(const BigInteger& dividend, const BigInteger& divisor,
+            BigInteger& quotient, BigInteger& remainder) {
+  Limbs quotient_digits;
+  Limbs remainder_digits;
+  BigInteger::DivModDigits(dividend.digits_, divisor.digits_, quotient_digits, remainder_digits);
+
+  Sign quotient_sign = dividend.sign_ * divisor.sign_;
+  Sign remainder_sign = dividend.sign_;
+  quotient.digits_ = std::move(quotient_digits);
+  quotient.sign_ = quotient_sign;
+  quotient.NormalizeDigits();
+  remainder.digits_ = std::move(remainder_digits);
+  remainder.sign_ = remainder_sign;
+  remainder.NormalizeDigits();
+}
+
+bool operator== (const BigInteger& first_num, const BigInteger& second_num) {
+  return first_num.sign_ == second_num.sign_ &&
+         BigInteger::CompareDigits(first_num.digits_, second_num.digits_) == 0;
+}
+
+bool operator!= (const BigInteger& first_num, const BigInteger& second_num) {
+  return !(first_num == second_num);
+}
+
+bool operator< (const BigInteger& first_num, const BigInteger& second_num) {
+  if ((first_num.sign_ == negative && second_num.sign_ == positive) ||
+      (first_num.sign_ == positive && second_num.sign_ == positive && 
+       first_num.digits_.size() < second_num.digits_.size()) ||
+      (first_num.sign_ == negative && second_num.sign_ == negative &&
+       first_num.digits_.size() > second_num.digits_.size())) {
+      return true;
+  }
+
+  if ((first_num.sign_ == positive && second_num.sign_ == negative) ||
+      (first_num.sign_ == positive && second_num.sign_ == positive && 
+       first_num.digits_.size() > second_num.digits_.size()) ||
+      (first_num.sign_ == negative && second_num.sign_ == negative &&
+       first_num.digits_.size() < second_num.digits_.size())) {
+      return false;
+  }
+
+  int compare = BigInteger::CompareDigits(first_num.digits_, second_num.digits_);
+  return first_num.sign_ == positive ? compare < 0 : compare > 0;
+}
+
+bool operator> (const BigInteger& first_num, const BigInteger& second_num) {
+  return second_num < first_num;
+}
+
+bool operator<= (const BigInteger& first_num, const BigInteger& second_num) {
+  return !(second_num < first_num);
+}
+
+bool operator>= (const BigInteger& first_num, const BigInteger& second_num) {
+  return !(first_num < second_num);
+}
+
+std::ostream& operator<< (std::ostream& output_stream, const BigInteger& num) {
+  output_stream << num.toString();
+  return output_stream;
+}
+
+std::istream& operator>> (std::istream& input_stream, BigInteger& num) {
+  return BigInteger::ReadDecimal(input_stream, num);
+}
+
+// Signed integer with a magnitude below 2^Bits, kept inline in 32-bit binary
+// words so that every loop has a fixed trip count. A result that does not fit
+// throws std::overflow_error, which in a constant expression is a compile
+// error instead.
+template <size_t Bits>
+class FixedBigInteger {
+ private:
+  template <size_t OtherBits>
+  friend class FixedBigInteger;
+
+  static constexpr size_t kWords = (Bits + 31) / 32;
+  static constexpr uint32_t kTopMask = Bits % 32 == 0 ? ~0u : (1u << (Bits % 32)) - 1;
+  // Both radices are at least 2^29.
+  static constexpr size_t kBaseLimbs = Bits / 29 + 1;
+
+  using Words = std::array<uint32_t, kWords>;
+
+  Words words_{};
+  Sign sign_ = positive;
+
+  constexpr bool IsZero() const {
+    for (uint32_t word : words_) {
+      if (word != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  constexpr void Normalize() {
+    if (IsZero()) {
+      sign_ = positive;
+    }
+  }
+
+  constexpr void CheckOverflow(uint64_t carry) const {
+    if (carry != 0 || (words_[kWords - 1] & ~kTopMask) != 0) {
+      throw std::overflow_error("FixedBigInteger: result does not fit");
+    }
+  }
+
+  template <size_t... Index>
+  static constexpr uint64_t AddWords(Words& target, const Words& addend,
+                                     std::index_sequence<Index...>) {
+    uint64_t carry = 0;
+    ((carry += (uint64_t)target[Index] + addend[Index], target[Index] = (uint32_t)carry,
+      carry >>= 32), ...);
+    return carry;
+  }
+
+  template <size_t... Index>
+  static constexpr void SubtractWords(Words& target, const Words& subtrahend,
+                                      std::index_sequence<Index...>) {
+    uint64_t borrow = 0;
+    ((borrow = (uint64_t)target[Index] - subtrahend[Index] - borrow,
+      target[Index] = (uint32_t)borrow, borrow >>= 63), ...);
+  }
+
+  template <size_t... Index>
+  static constexpr int CompareWords(const Words& first, const Words& second,
+                                    std::index_sequence<Index...>) {
+    int result = 0;
+    ((result = result != 0 || first[kWords - 1 - Index] == second[kWords - 1 - Index]
+                   ? result
+                   : (first[kWords - 1 - Index] < second[kWords - 1 - Index] ? -1 : 1)),
+     ...);
+    return result;
+  }
+
+  static constexpr int CompareWords(const Words& first, const Words& second) {
+    return CompareWords(first, second, std::make_index_sequence<kWords>{});
+  }
+
+  // Adds a signed magnitude in place, like BigInteger::AddSigned.
+  constexpr void AddSigned(const Words& words, Sign words_sign) {
+    if (sign_ == words_sign) {
+      CheckOverflow(AddWords(words_, words, std::make_index_sequence<kWords>{}));
+    } else if (CompareWords(words_, words) >= 0) {
+      SubtractWords(words_, words, std::make_index_sequence<kWords>{});
+    } else {
+      Words result = words;
+      SubtractWords(result, words_, std::make_index_sequence<kWords>{});
+      words_ = result;
+      sign_ = words_sign;
+    }
+
+    Normalize();
+  }
+
+  static constexpr uint32_t DivideWordsBySmall(Words& words, uint32_t divisor) {
+    uint64_t remainder = 0;
+    for (size_t i = kWords; i-- > 0;) {
+      uint64_t current = remainder << 32 | words[i];
+      words[i] = (uint32_t)(current / divisor);
+      remainder = current % divisor;
+    }
+    return (uint32_t)remainder;
+  }
+
+  // Knuth's Algorithm D on 32-bit words, with the divisor normalized so that
+  // its top bit is set.
+  static constexpr void DivModWords(const Words& dividend, const Words& divisor,
+                                    Words& quotient, Words& remainder) {
+    size_t divisor_size = kWords;
+    while (divisor_size > 0 && divisor[divisor_size - 1] == 0) {
+      --divisor_size;
+    }
+    if (divisor_size == 0) {
+      throw std::domain_error("FixedBigInteger: division by zero");
+    }
+
+    quotient = Words{};
+    remainder = Words{};
+    if (divisor_size == 1) {
+      quotient = dividend;
+      remainder[0] = DivideWordsBySmall(quotient, divisor[0]);
+      return;
+    }
+
+    size_t dividend_size = kWords;
+    while (dividend_size > 0 && dividend[dividend_size - 1] == 0) {
+      --dividend_size;
+    }
+    if (dividend_size < divisor_size) {
+      remainder = dividend;
+      return;
+    }
+
+    int shift = std::countl_zero(divisor[divisor_size - 1]);
+    std::array<uint32_t, kWords> scaled_divisor{};
+    std::array<uint32_t, kWords + 1> scaled_dividend{};
+    for (size_t i = divisor_size; i-- > 0;) {
+      uint64_t low = i > 0 ? (uint64_t)divisor[i - 1] >> (32 - shift) : 0;
+      scaled_divisor[i] = (uint32_t)((uint64_t)divisor[i] << shift | low);
+    }
+    scaled_dividend[dividend_size] = (uint32_t)((uint64_t)dividend[dividend_size - 1] >> (32 - shift));
+    for (size_t i = dividend_size; i-- > 0;) {
+      uint64_t low = i > 0 ? (uint64_t)dividend[i - 1] >> (32 - shift) : 0;
+      scaled_dividend[i] = (uint32_t)((uint64_t)dividend[i] << shift | low);
+    }
+
+    const uint64_t base = (uint64_t)1 << 32;
+    uint64_t top = scaled_divisor[divisor_size - 1];
+    uint64_t next = scaled_divisor[divisor_size - 2];
+    for (size_t j = dividend_size - divisor_size + 1; j-- > 0;) {
+      uint64_t current = (uint64_t)scaled_dividend[j + divisor_size] << 32 |
+                         scaled_dividend[j + divisor_size - 1];
+      uint64_t estimate = current / top;
+      uint64_t estimate_remainder = current % top;
+      while (estimate >= base ||
+             estimate * next > (estimate_remainder << 32 | scaled_dividend[j + divisor_size - 2])) {
+        --estimate;
+        estimate_remainder += top;
+        if (estimate_remainder >= base) {
+          break;
+        }
+      }
+
+      int64_t borrow = 0;
+      for (size_t i = 0; i < divisor_size; ++i) {
+        uint64_t product = estimate * scaled_divisor[i];
+        int64_t difference = (int64_t)scaled_dividend[i + j] - borrow - (int64_t)(product & 0xFFFFFFFF);
+        scaled_dividend[i + j] = (uint32_t)difference;
+        borrow = (int64_t)(product >> 32) - (difference >> 32);
+      }
+      int64_t difference = (int64_t)scaled_dividend[j + divisor_size] - borrow;
+      scaled_dividend[j + divisor_size] = (uint32_t)difference;
+
+      if (difference < 0) {
+        --estimate;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < divisor_size; ++i) {
+          carry += (uint64_t)scaled_dividend[i + j] + scaled_divisor[i];
+          scaled_dividend[i + j] = (uint32_t)carry;
+          carry >>= 32;
+        }
+        scaled_dividend[j + divisor_size] += (uint32_t)carry;
+      }
+      quotient[j] = (uint32_t)estimate;
+    }
+
+    for (size_t i = 0; i < divisor_size; ++i) {
+      uint64_t high = (uint64_t)scaled_dividend[i + 1] << (32 - shift);
+      remainder[i] = (uint32_t)(scaled_dividend[i] >> shift | (shift != 0 ? high : 0));
+    }
+  }
+
+ public:
+  constexpr FixedBigInteger() {}
+
+  constexpr FixedBigInteger(int num) : FixedBigInteger((long long)num) {}
+
+  constexpr FixedBigInteger(long long num) : FixedBigInteger(num < 0 ? 0ull - num : num) {
+    sign_ = num < 0 ? negative : positive;
+  }
+
+  constexpr explicit FixedBigInteger(unsigned long long num) {
+    for (size_t i = 0; i < kWords && num != 0; ++i) {
+      words_[i] = (uint32_t)num;
+      num = num >> 16 >> 16;
+    }
+    CheckOverflow(num);
+  }
+
+  constexpr explicit FixedBigInteger(std::string_view string) {
+    size_t begin = !string.empty() && (string[0] == '-' || string[0] == '+') ? 1 : 0;
+    if (begin == string.size()) {
+      throw std::invalid_argument("FixedBigInteger: not a decimal integer");
+    }
+
+    for (size_t i = begin; i < string.size(); ++i) {
+      if (string[i] < '0' || string[i] > '9') {
+        throw std::invalid_argument("FixedBigInteger: not a decimal integer");
+      }
+      *this *= FixedBigInteger(10);
+      *this += FixedBigInteger(string[i] - '0');
+    }
+
+    sign_ = string[0] == '-' ? negative : positive;
+    Normalize();
+  }
+
+  // Widening is implicit; narrowing is explicit and checked.
+  template <size_t OtherBits>
+  constexpr explicit(OtherBits > Bits) FixedBigInteger(const FixedBigInteger<OtherBits>& num) {
+    for (size_t i = 0; i < FixedBigInteger<OtherBits>::kWords; ++i) {
+      if (i < kWords) {
+        words_[i] = num.words_[i];
+      } else if (num.words_[i] != 0) {
+        throw std::overflow_error("FixedBigInteger: result does not fit");
+      }
+    }
+    CheckOverflow(0);
+    sign_ = num.sign_;
+  }
+
+  explicit FixedBigInteger(const BigInteger& num) {
+    Limbs words = BigInteger::ConvertRadix(num.digits_, kBase, (long long)1 << 32);
+    BigInteger::TrimDigits(words);
+    if (words.size() > kWords) {
+      throw std::overflow_error("FixedBigInteger: result does not fit");
+    }
+
+    std::copy(words.begin(), words.end(), words_.begin());
+    CheckOverflow(0);
+    sign_ = num.sign_;
+    Normalize();
+  }
+
+  explicit operator BigInteger() const {
+    Limbs words(kWords, 0);
+    std::copy(words_.begin(), words_.end(), words.begin());
+    BigInteger result = BigInteger::FromDigits(
+        BigInteger::ConvertRadix(words, (long long)1 << 32, kBase));
+    if (sign_ == negative) {
+      result = -std::move(result);
+    }
+    return result;
+  }
+
+  // The magnitude in the radix of BigInteger, least significant limb first,
+  // with zero limbs on top.
+  constexpr std::array<long long, kBaseLimbs> BaseLimbs() const {
+    std::array<long long, kBaseLimbs> limbs{};
+    Words rest = words_;
+    for (size_t i = 0; i < kBaseLimbs && rest != Words{}; ++i) {
+      limbs[i] = DivideWordsBySmall(rest, kBase);
+    }
+    return limbs;
+  }
+
+  constexpr explicit operator bool() const {
+    return !IsZero();
+  }
+
+  constexpr FixedBigInteger operator- () const {
+    FixedBigInteger result = *this;
+    if (!IsZero()) {
+      result.sign_ = sign_ == positive ? negative : positive;
+    }
+    return result;
+  }
+
+  constexpr FixedBigInteger& operator+= (const FixedBigInteger& second_num) {
+    AddSigned(second_num.words_, second_num.sign_);
+    return *this;
+  }
+
+  constexpr FixedBigInteger& operator-= (const FixedBigInteger& second_num) {
+    AddSigned(second_num.words_, second_num.sign_ == positive ? negative : positive);
+    return *this;
+  }
+
+  constexpr FixedBigInteger& operator*= (const FixedBigInteger& second_num) {
+    std::array<uint32_t, 2 * kWords> product{};
+    for (size_t i = 0; i < kWords; ++i) {
+      uint64_t carry = 0;
+      for (size_t j = 0; j < kWords; ++j) {
+        carry += (uint64_t)words_[i] * second_num.words_[j] + product[i + j];
+        product[i + j] = (uint32_t)carry;
+        carry >>= 32;
+      }
+      product[i + kWords] = (uint32_t)carry;
+    }
+
+    uint64_t high = 0;
+    for (size_t i = 0; i < kWords; ++i) {
+      words_[i] = product[i];
+      high |= product[i + kWords];
+    }
+    CheckOverflow(high);
+    sign_ = sign_ == second_num.sign_ ? positive : negative;
+    Normalize();
+    return *this;
+  }
+
+  constexpr FixedBigInteger& operator/= (const FixedBigInteger& second_num) {
+    Words remainder{};
+    DivModWords(Words(words_), Words(second_num.words_), words_, remainder);
+    sign_ = sign_ == second_num.sign_ ? positive : negative;
+    Normalize();
+    return *this;
+  }
+
+  constexpr FixedBigInteger& operator%= (const FixedBigInteger& second_num) {
+    Words quotient{};
+    DivModWords(Words(words_), Words(second_num.words_), quotient, words_);
+    Normalize();
+    return *this;
+  }
+
+  constexpr FixedBigInteger& operator++ () {
+    return *this += 1;
+  }
+
+  constexpr FixedBigInteger& operator-- () {
+    return *this -= 1;
+  }
+
+  constexpr FixedBigInteger operator++ (int) {
+    FixedBigInteger temp = *this;
+    *this += 1;
+    return temp;
+  }
+
+  constexpr FixedBigInteger operator-- (int) {
+    FixedBigInteger temp = *this;
+    *this -= 1;
+    return temp;
+  }
+
+  std::string toString() const {
+    std::string result;
+    Words rest = words_;
+    do {
+      uint32_t chunk = DivideWordsBySmall(rest, kDecimalBase);
+      for (int i = 0; i < kDecimalBaseLength; ++i, chunk /= 10) {
+        result.push_back(char('0' + chunk % 10));
+      }
+    } while (rest != Words{});
+
+    while (result.size() > 1 && result.back() == '0') {
+      result.pop_back();
+    }
+    if (sign_ == negative) {
+      result.push_back('-');
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+  }
+
+  friend constexpr FixedBigInteger operator+ (FixedBigInteger first_num,
+                                              const FixedBigInteger& second_num) {
+    return first_num += second_num;
+  }
+
+  friend constexpr FixedBigInteger operator- (FixedBigInteger first_num,
+                                              const FixedBigInteger& second_num) {
+    return first_num -= second_num;
+  }
+
+  friend constexpr FixedBigInteger operator* (FixedBigInteger first_num,
+                                              const FixedBigInteger& second_num) {
+    return first_num *= second_num;
+  }
+
+  friend constexpr FixedBigInteger operator/ (FixedBigInteger first_num,
+                                              const FixedBigInteger& second_num) {
+    return first_num /= second_num;
+  }
+
+  friend constexpr FixedBigInteger operator% (FixedBigInteger first_num,
+                                              const FixedBigInteger& second_num) {
+    return first_num %= second_num;
+  }
+
+  friend constexpr bool operator== (const FixedBigInteger& first_num,
+                                    const FixedBigInteger& second_num) {
+    return first_num.sign_ == second_num.sign_ && first_num.words_ == second_num.words_;
+  }
+
+  friend constexpr bool operator!= (const FixedBigInteger& first_num,
+                                    const FixedBigInteger& second_num) {
+    return !(first_num == second_num);
+  }
+
+  friend constexpr bool operator< (const FixedBigInteger& first_num,
+                                   const FixedBigInteger& second_num) {
+    if (first_num.sign_ != second_num.sign_) {
+      return first_num.sign_ == negative;
+    }
+    int compare = CompareWords(first_num.words_, second_num.words_);
+    return first_num.sign_ == positive ? compare < 0 : compare > 0;
+  }
+
+  friend constexpr bool operator> (const FixedBigInteger& first_num,
+                                   const FixedBigInteger& second_num) {
+    return second_num < first_num;
+  }
+
+  friend constexpr bool operator<= (const FixedBigInteger& first_num,
+                                    const FixedBigInteger& second_num) {
+    return !(second_num < first_num);
+  }
+
+  friend constexpr bool operator>= (const FixedBigInteger& first_num,
+                                    const FixedBigInteger& second_num) {
+    return !(first_num < second_num);
+  }
+
+  friend std::ostream& operator<< (std::ostream& output_stream, const FixedBigInteger& num) {
+    output_stream << num.toString();
+    return output_stream;
+  }
+
+  friend std::istream& operator>> (std::istream& input_stream, FixedBigInteger& num) {
+    std::string string;
+    input_stream >> string;
+    num = FixedBigInteger(std::string_view(string));
+    return input_stream;
+  }
+};
+
+// Radix of an integer literal and the length of its prefix: 0x or 0X for
+// hexadecimal, 0b or 0B for binary, a leading 0 for octal.
+constexpr std::pair<int, size_t> LiteralRadix(std::string_view literal) {
+  if (literal.size() > 1 && literal[0] == '0') {
+    if (literal[1] == 'x' || literal[1] == 'X') {
+      return {16, 2};
+    }
+    if (literal[1] == 'b' || literal[1] == 'B') {
+      return {2, 2};
+    }
+    return {8, 1};
+  }
+  return {10, 0};
+}
+
+// An upper bound on the bits of the value, separators counted as digits.
+constexpr size_t LiteralBits(std::string_view literal) {
+  auto [radix, prefix] = LiteralRadix(literal);
+  size_t digits = literal.size() - prefix;
+  size_t bits = radix == 16 ? 4 * digits : radix == 8 ? 3 * digits : radix == 2 ? digits
+                                                                               : digits * 10 / 3;
+  return bits + 1;
+}
+
+// Integer literals in any of the four radices, digit separators allowed,
+// are parsed during compilation into a FixedBigInteger just wide enough for
+// them; a malformed literal is a compile error.
+template <char... Chars>
+constexpr char kLiteralSymbols[] = {Chars...};
+
+template <char... Chars>
+consteval auto operator"" _fbi() {
+  constexpr std::string_view kView(kLiteralSymbols<Chars...>, sizeof...(Chars));
+  using Fixed = FixedBigInteger<LiteralBits(kView)>;
+
+  auto [radix, prefix] = LiteralRadix(kView);
+  if (prefix == kView.size()) {
+    throw std::invalid_argument("FixedBigInteger: not an integer literal");
+  }
+  Fixed value;
+  for (char symbol : kView.substr(prefix)) {
+    if (symbol == '\'') {
+      continue;
+    }
+    int digit = symbol >= '0' && symbol <= '9'   ? symbol - '0'
+                : symbol >= 'a' && symbol <= 'f' ? symbol - 'a' + 10
+                : symbol >= 'A' && symbol <= 'F' ? symbol - 'A' + 10
+                                                 : radix;
+    if (digit >= radix) {
+      throw std::invalid_argument("FixedBigInteger: not an integer literal");
+    }
+    value *= Fixed(radix);
+    value += Fixed(digit);
+  }
+  return value;
+}
+
+// The limbs of a _bi literal are computed during compilation as well, so at
+// run time it only costs copying them, whatever its length.
+template <char... Chars>
+BigInteger operator"" _bi() {
+  static constexpr auto kLimbs = operator"" _fbi<Chars...>().BaseLimbs();
+  return BigInteger::FromDigits(Limbs(kLimbs.data(), kLimbs.data() + kLimbs.size()));
+}
+
+// Caches floor(kBase^(2n) / |divisor|) for an n-limb divisor, so that every
+// later division by it costs two multiplications per n-limb block of the
+// dividend (Barrett reduction) instead of a full long division.
+class BigIntegerReciprocal {
+ private:
+  Limbs divisor_;
+  Limbs inverse_;
+  Sign sign_ = positive;
+
+  void DivModMagnitude(const Limbs& dividend, Limbs& quotient, Limbs& remainder) const {
+    size_t block = divisor_.size();
+    size_t block_count = (dividend.size() + block - 1) / block;
+    quotient.assign(block_count * block, 0);
+    remainder.clear();
+
+    for (int i = (int)block_count - 1; i >= 0; --i) {
+      Limbs current = BigInteger::ShiftDigits(remainder, block);
+      BigInteger::AddDigitsTo(current, BigInteger::SliceDigits(dividend, i * block, (i + 1) * block));
+      BigInteger::TrimDigits(current);
+
+      Limbs block_quotient = BigInteger::MultiplyDigits(
+          BigInteger::SliceDigits(current, block - 1, current.size()), inverse_);
+      block_quotient = BigInteger::SliceDigits(block_quotient, block + 1, block_quotient.size());
+      BigInteger::SubtractDigitsFrom(current, BigInteger::MultiplyDigits(block_quotient, divisor_));
+
+      while (BigInteger::CompareDigits(current, divisor_) >= 0) {
+        BigInteger::SubtractDigitsFrom(current, divisor_);
+        BigInteger::AddDigitsTo(block_quotient, {1});
+      }
+
+      std::copy(block_quotient.begin(), block_quotient.end(), quotient.begin() + i * block);
+      remainder = std::move(current);
+    }
+
+    BigInteger::TrimDigits(quotient);
+  }
+
+ public:
+  explicit BigIntegerReciprocal(const BigInteger& divisor)
+      : divisor_(divisor.digits_), sign_(divisor.sign_) {
+    BigInteger::TrimDigits(divisor_);
+
+    Limbs power(2 * divisor_.size(), 0);
+    power.push_back(1);
+    Limbs remainder;
+    BigInteger::DivModDigits(power, divisor_, inverse_, remainder);
+  }
+
+  void DivMod(const BigInteger& dividend, BigInteger& quotient, BigInteger& remainder) const {
+    Limbs quotient_digits;
+    Limbs remainder_digits;
+    DivModMagnitude(dividend.digits_, quotient_digits, remainder_digits);
+
+    Sign dividend_sign = dividend.sign_;
+    quotient = BigInteger::FromDigits(std::move(quotient_digits));
+    remainder = BigInteger::FromDigits(std::move(remainder_digits));
+    if (dividend_sign * sign_ == negative) {
+      quotient = -quotient;
+    }
+    if (dividend_sign == negative) {
+      remainder = -remainder;
+    }
   }
 
-  BigInteger& operator++ () {
-    return *this += 1;
+  BigInteger Divide(const BigInteger& dividend) const {
+    BigInteger quotient;
+    BigInteger remainder;
+    DivMod(dividend, quotient, remainder);
+    return quotient;
   }
 
-  BigInteger& operator-- () {
-    return *this -= 1;
+  BigInteger Modulo(const BigInteger& dividend) const {
+    BigInteger quotient;
+    BigInteger remainder;
+    DivMod(dividend, quotient, remainder);
+    return remainder;
   }
+};
 
-  BigInteger& operator= (const BigInteger& num)  = default;
+// Modular arithmetic for a fixed modulus coprime with kBase (odd, and in the
+// decimal radix not divisible by 5). Values are kept in Montgomery form
+// x * R mod N with R = kBase^n, so a modular product costs three
+// multiplications and no division.
+class MontgomeryContext {
+ private:
+  Limbs modulus_;
+  Limbs inverse_;
+  Limbs r_squared_;
+  Limbs one_;
 
-  std::string toString() const {
-    std::string result = std::to_string(digits_.back());
+  Limbs Reduce(const Limbs& value) const {
+    size_t size = modulus_.size();
+    Limbs factor = BigInteger::SliceDigits(
+        BigInteger::MultiplyDigits(BigInteger::SliceDigits(value, 0, size), inverse_), 0, size);
+    Limbs sum = BigInteger::MultiplyDigits(factor, modulus_);
+    BigInteger::AddDigitsTo(sum, value);
 
-    for (int i = (int)digits_.size() - 2; i >= 0; --i) {
-      std::string digit_str = std::to_string(digits_[i]);
-      result += std::string(kBaseLength - digit_str.size(), '0') + digit_str;
+    Limbs result = BigInteger::SliceDigits(sum, size, sum.size());
+    if (BigInteger::CompareDigits(result, modulus_) >= 0) {
+      BigInteger::SubtractDigitsFrom(result, modulus_);
     }
+    return result;
+  }
 
-    size_t first_non_zero = 0;
+  Limbs Multiply(const Limbs& first, const Limbs& second) const {
+    return Reduce(BigInteger::MultiplyDigits(first, second));
+  }
 
-    while (result[first_non_zero] == '0' && first_non_zero < result.size() - 1) {
-      ++first_non_zero;
+  Limbs Residue(const BigInteger& value) const {
+    Limbs quotient;
+    Limbs remainder;
+    BigInteger::DivModDigits(value.digits_, modulus_, quotient, remainder);
+    if (value.sign_ == negative && !remainder.empty()) {
+      BigInteger::SubtractDigitsFromReversed(remainder, modulus_);
     }
-
-    result = result.substr(first_non_zero, result.size());
-    return sign_ == negative ? "-" + result : result;
+    return remainder;
   }
 
-  BigInteger() {}
+  Limbs ToMontgomery(const BigInteger& value) const {
+    return Multiply(Residue(value), r_squared_);
+  }
 
-  BigInteger(int num) {
-    sign_ = (num < 0) ? negative : positive;
+  BigInteger FromMontgomery(const Limbs& value) const {
+    return BigInteger::FromDigits(Reduce(value));
+  }
 
-    if (num == 0) {
-      digits_.push_back(0);
+ public:
+  explicit MontgomeryContext(const BigInteger& modulus) : modulus_(modulus.digits_) {
+    BigInteger::TrimDigits(modulus_);
+    if (modulus_.empty() || std::gcd(modulus_[0], (long long)kBase) != 1) {
+      throw std::invalid_argument("MontgomeryContext: modulus must be coprime with the base");
     }
 
-    BuildFromUll((unsigned long long)std::abs(num));
-  }
+    size_t size = modulus_.size();
+    Limbs base_power(size + 1, 0);
+    base_power[size] = 1;
+    inverse_ = BigInteger::InverseModBasePower(modulus_, size);
+    BigInteger::SubtractDigitsFromReversed(inverse_, base_power);
+    inverse_ = BigInteger::SliceDigits(inverse_, 0, size);
 
-  explicit BigInteger(unsigned long long num) {
-    BuildFromUll(num);
+    Limbs quotient;
+    BigInteger::DivModDigits(base_power, modulus_, quotient, one_);
+    BigInteger::DivModDigits(BigInteger::ShiftDigits({1}, 2 * size), modulus_, quotient,
+                             r_squared_);
   }
 
-  BigInteger(const BigInteger& num) = default;
+  BigInteger MulMod(const BigInteger& first, const BigInteger& second) const {
+    return FromMontgomery(Multiply(ToMontgomery(first), ToMontgomery(second)));
+  }
 
-  BigInteger(const std::string& string) {
-    int start = 0;
+  BigInteger SqrMod(const BigInteger& value) const {
+    Limbs converted = ToMontgomery(value);
+    return FromMontgomery(Multiply(converted, converted));
+  }
 
-    if (string[0] == '-') {
-      start = 1;
-      sign_ = negative;
+  BigInteger PowMod(const BigInteger& base, const BigInteger& exponent) const {
+    if (exponent < 0) {
+      throw std::invalid_argument("MontgomeryContext: negative exponent");
     }
 
-    for (int i = (int)string.size() - 1; i >= start; i -= kBaseLength) {
-      int start_index = std::max(i - kBaseLength + 1, start);
-      digits_.push_back(std::stoi(string.substr(start_index, i - start_index + 1)));
+    Limbs result = BigInteger::SlidingWindowPower(
+        ToMontgomery(base), one_, exponent,
+        [this](const Limbs& first, const Limbs& second) { return Multiply(first, second); });
+    return FromMontgomery(result);
+  }
+};
+
+// The same interface for moduli that share a factor with kBase, where
+// Montgomery form does not exist; every reduction is a Barrett step through
+// a cached reciprocal.
+class BarrettContext {
+ private:
+  BigInteger modulus_;
+  BigIntegerReciprocal reciprocal_;
+
+  BigInteger Residue(const BigInteger& value) const {
+    BigInteger remainder = reciprocal_.Modulo(value);
+    if (remainder < 0) {
+      remainder += modulus_;
     }
+    return remainder;
   }
 
-  explicit operator bool() const {
-    return digits_.size() != 1 || digits_[0] != 0;
+ public:
+  explicit BarrettContext(const BigInteger& modulus)
+      : modulus_(modulus < 0 ? -modulus : modulus), reciprocal_(modulus_) {}
+
+  BigInteger MulMod(const BigInteger& first, const BigInteger& second) const {
+    return Residue(Residue(first) * Residue(second));
   }
 
-  friend bool operator== (const BigInteger& first_num, const BigInteger& second_num);
-  friend bool operator< (const BigInteger& first_num, const BigInteger& second_num);
-  friend bool operator<= (const BigInteger& first_num, const BigInteger& second_num);
+  BigInteger SqrMod(const BigInteger& value) const {
+    BigInteger residue = Residue(value);
+    return Residue(residue * residue);
+  }
+
+  BigInteger PowMod(const BigInteger& base, const BigInteger& exponent) const {
+    if (exponent < 0) {
+      throw std::invalid_argument("BarrettContext: negative exponent");
+    }
+
+    return BigInteger::SlidingWindowPower(
+        Residue(base), Residue(1), exponent,
+        [this](const BigInteger& first, const BigInteger& second) {
+          return reciprocal_.Modulo(first * second);
+        });
+  }
 };
 
-BigInteger operator+ (const BigInteger& num1, const BigInteger& num2) {
-  BigInteger result = num1;
-  result += num2;
-  return result;
-}
+BigInteger PowMod(const BigInteger& base, const BigInteger& exponent, const BigInteger& modulus) {
+  if (modulus % 2 != 0 && (kBase != kDecimalBase || modulus % 5 != 0)) {
+    return MontgomeryContext(modulus).PowMod(base, exponent);
+  }
 
-BigInteger operator- (const BigInteger& num1, const BigInteger& num2) {
-  BigInteger result = num1;
-  result -= num2;
-  return result;
+  return BarrettContext(modulus).PowMod(base, exponent);
 }
 
-BigInteger operator* (const BigInteger& num1, const BigInteger& num2) {
-  BigInteger result = num1;
-  result *= num2;
-  return result;
-}
+// Calls function(i) for every i below count. When parallel is set, the
+// indices are dealt out to up to ThreadCount() tasks for RunTasks, which
+// shares the caller's arena with them and keeps to the thread budget.
+template <typename Function>
+void ForEachIndex(size_t count, bool parallel, Function function) {
+  size_t workers = parallel ? std::min(ThreadCount(), count) : 1;
+  if (workers <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      function(i);
+    }
+    return;
+  }
 
-BigInteger operator/ (const BigInteger& num1, const BigInteger& num2) {
-  BigInteger result = num1;
-  result /= num2;
-  return result;
+  std::vector<std::function<void()>> tasks;
+  for (size_t worker = 0; worker < workers; ++worker) {
+    tasks.push_back([&function, count, workers, worker] {
+      for (size_t i = worker; i < count; i += workers) {
+        function(i);
+      }
+    });
+  }
+  RunTasks(tasks);
 }
 
-BigInteger operator% (const BigInteger& num1, const BigInteger& num2) {
-  BigInteger result = num1;
-  result %= num2;
-  return result;
-}
+// Multiplies neighbours level by level, so every product joins operands of
+// similar size and the large ones reach the fast multiplication tiers.
+BigInteger ProductTree(std::vector<BigInteger> values, bool parallel = false) {
+  if (values.empty()) {
+    return 1;
+  }
 
-bool operator== (const BigInteger& first_num, const BigInteger& second_num) {
-  return first_num.digits_ == second_num.digits_ && first_num.sign_ == second_num.sign_;
-}
+  while (values.size() > 1) {
+    ForEachIndex(values.size() / 2, parallel, [&values](size_t i) {
+      values[2 * i] *= values[2 * i + 1];
+    });
 
-bool operator!= (const BigInteger& first_num, const BigInteger& second_num) {
-  return !(first_num == second_num);
+    for (size_t i = 0; i < (values.size() + 1) / 2; ++i) {
+      values[i] = std::move(values[2 * i]);
+    }
+    values.resize((values.size() + 1) / 2);
+  }
+
+  return std::move(values[0]);
 }
 
-bool operator< (const BigInteger& first_num, const BigInteger& second_num) {
-  if ((first_num.sign_ == negative && second_num.sign_ == positive) ||
-      (first_num.sign_ == positive && second_num.sign_ == positive && 
-       first_num.digits_.size() < second_num.digits_.size()) ||
-      (first_num.sign_ == negative && second_num.sign_ == negative &&
-       first_num.digits_.size() > second_num.digits_.size())) {
-      return true;
+template <typename Iterator>
+BigInteger Product(Iterator first, Iterator last, bool parallel = false) {
+  std::vector<BigInteger> values;
+  for (; first != last; ++first) {
+    values.emplace_back(*first);
   }
 
-  if ((first_num.sign_ == positive && second_num.sign_ == negative) ||
-      (first_num.sign_ == positive && second_num.sign_ == positive && 
-       first_num.digits_.size() > second_num.digits_.size()) ||
-      (first_num.sign_ == negative && second_num.sign_ == negative &&
-       first_num.digits_.size() < second_num.digits_.size())) {
-      return false;
+  return ProductTree(std::move(values), parallel);
+}
+
+// Product of low..high; consecutive factors are first packed into 64-bit
+// words so the tree starts from as few leaves as possible.
+BigInteger RangeProduct(unsigned long long low, unsigned long long high, bool parallel = false) {
+  std::vector<BigInteger> values;
+  unsigned long long packed = 1;
+
+  if (low == 0) {
+    return 0;
   }
 
-  for (int i = (int)first_num.digits_.size() - 1; i >= 0; i--) {
-    if ((first_num.digits_[i] < second_num.digits_[i] && first_num.sign_ == positive) ||
-        (first_num.digits_[i] > second_num.digits_[i] && first_num.sign_ == negative)) {
-      return true;
+  for (unsigned long long factor = low; factor <= high; ++factor) {
+    if (packed > ~0ull / factor) {
+      values.emplace_back(packed);
+      packed = 1;
     }
+    packed *= factor;
 
-    if ((first_num.digits_[i] < second_num.digits_[i] && first_num.sign_ == negative) ||
-        (first_num.digits_[i] > second_num.digits_[i] && first_num.sign_ == positive)) {
-      return false;
+    if (factor == high) {
+      break;
     }
   }
+  values.emplace_back(packed);
 
-  return false;
+  return ProductTree(std::move(values), parallel);
 }
 
-bool operator> (const BigInteger& first_num, const BigInteger& second_num) {
-  return second_num < first_num;
+BigInteger Factorial(unsigned long long num, bool parallel = false) {
+  return RangeProduct(2, num, parallel);
 }
 
-bool operator<= (const BigInteger& first_num, const BigInteger& second_num) {
-  return !(second_num < first_num);
-}
+BigInteger Binomial(unsigned long long num, unsigned long long count, bool parallel = false) {
+  if (count > num) {
+    return 0;
+  }
 
-bool operator>= (const BigInteger& first_num, const BigInteger& second_num) {
-  return !(first_num < second_num);
+  count = std::min(count, num - count);
+  return RangeProduct(num - count + 1, num, parallel) / Factorial(count, parallel);
 }
 
-BigInteger operator"" _bi(unsigned long long num) {
-  return BigInteger{num};
+// value % moduli[i] for every modulus at once: the moduli are multiplied up a
+// product tree and value is reduced down it, so each remainder is taken from
+// a number about the size of its modulus instead of from value itself.
+std::vector<BigInteger> RemainderTree(const BigInteger& value, const std::vector<BigInteger>& moduli,
+                                      bool parallel = false) {
+  if (moduli.empty()) {
+    return {};
+  }
+
+  std::vector<std::vector<BigInteger>> levels = {moduli};
+  while (levels.back().size() > 1) {
+    const std::vector<BigInteger>& below = levels.back();
+    std::vector<BigInteger> above((below.size() + 1) / 2);
+    ForEachIndex(above.size(), parallel, [&](size_t i) {
+      above[i] = 2 * i + 1 < below.size() ? below[2 * i] * below[2 * i + 1] : below[2 * i];
+    });
+    levels.push_back(std::move(above));
+  }
+
+  std::vector<BigInteger> remainders = {value % levels.back()[0]};
+  for (int level = (int)levels.size() - 2; level >= 0; --level) {
+    const std::vector<BigInteger>& current = levels[level];
+    std::vector<BigInteger> next(current.size());
+    ForEachIndex(current.size(), parallel, [&](size_t i) {
+      next[i] = remainders[i / 2] % current[i];
+    });
+    remainders = std::move(next);
+  }
+
+  return remainders;
 }
 
-BigInteger operator"" _bi(const char* str) {
-  return BigInteger{std::string{str}};
+BigInteger Gcd(BigInteger num1, BigInteger num2) {
+  return BigInteger::FromDigits(BigInteger::GcdDigits(std::move(num1.digits_),
+                                                      std::move(num2.digits_)));
 }
 
-std::ostream& operator<< (std::ostream& output_stream, const BigInteger& num) {
-  output_stream << num.toString();
-  return output_stream;
+// Trailing zero limbs of the base turn into one shift of the result; the
+// rest goes through PowerDigits, which sizes its buffers from the exponent
+// up front, so the cost is dominated by the last few squarings.
+BigInteger Pow(const BigInteger& base, unsigned long long exponent) {
+  size_t zero_limbs = 0;
+  while (zero_limbs + 1 < base.digits_.size() && base.digits_[zero_limbs] == 0) {
+    ++zero_limbs;
+  }
+
+  Limbs digits = BigInteger::PowerDigits(
+      zero_limbs == 0 ? base.digits_ : BigInteger::SliceDigits(base.digits_, zero_limbs, base.digits_.size()),
+      exponent);
+  if (zero_limbs != 0) {
+    digits = BigInteger::ShiftDigits(digits, zero_limbs * exponent);
+  }
+  BigInteger result = BigInteger::FromDigits(std::move(digits));
+  if (base.sign_ == negative && exponent % 2 == 1) {
+    result = -std::move(result);
+  }
+  return result;
 }
 
-std::istream& operator>> (std::istream& input_stream, BigInteger& num) {
-  std::string string;
-  input_stream >> string;
-  num = string;
-  return input_stream;
+BigInteger ISqrt(const BigInteger& value) {
+  if (value < 0) {
+    throw std::domain_error("ISqrt: negative argument");
+  }
+  return value ? BigInteger::Root(value, 2) : value;
 }
 
-BigInteger Gcd(BigInteger num1, BigInteger num2) {
-  if (num2 == 0) {
-    return num1;
+// floor(value^(1 / degree)), rounded towards zero for negative values and
+// odd degrees.
+BigInteger IRoot(const BigInteger& value, unsigned long long degree) {
+  if (degree == 0 || (value < 0 && degree % 2 == 0)) {
+    throw std::domain_error("IRoot: no real root");
+  }
+  if (degree == 1 || !value) {
+    return value;
+  }
+  if (value < 0) {
+    return -BigInteger::Root(-value, degree);
   }
-  return Gcd(num2, num1 % num2);
+  return BigInteger::Root(value, degree);
 }
 
 class Rational {
  private:
+  // Kept in lowest terms, except that with
+  // BIGINTEGER_RATIONAL_NORMALIZE_THRESHOLD set the reduction waits until a
+  // part reaches that many limbs. Observers then work on a reduced copy, so
+  // reading a shared Rational never writes to it.
   BigInteger num = 0;
   BigInteger denom = 1;
+#ifdef BIGINTEGER_CACHE_HASH
+  HashCache hash_;
+#endif
+
+  void ForgetHash() {
+#ifdef BIGINTEGER_CACHE_HASH
+    hash_.Clear();
+#endif
+  }
+
+  void Reduce() {
+    long long small_num = 0;
+    long long small_denom = 0;
+    if (num.ReadSmall(small_num) && denom.ReadSmall(small_denom)) {
+      long long gcd = BigInteger::BinaryGcd(Magnitude(small_num), Magnitude(small_denom));
+      if (gcd > 1) {
+        num.AssignWide(small_num / gcd);
+        denom.AssignWide(small_denom / gcd);
+      }
+      return;
+    }
 
-  void Normalize() {
     BigInteger gcd = Gcd(num, denom);
-    num /= gcd;
-    denom /= gcd;
+    if (gcd != 1) {
+      num /= gcd;
+      denom /= gcd;
+    }
+  }
+
+  // *this when it is known to be reduced, otherwise a reduced copy of it in
+  // storage.
+  const Rational& ReducedForm(Rational& storage) const {
+    if (kRationalNormalizeThreshold == 0) {
+      return *this;
+    }
+    storage = *this;
+    storage.Reduce();
+    return storage;
+  }
+
+  static unsigned long long Magnitude(long long value) {
+    return value < 0 ? -(unsigned long long)value : value;
+  }
+
+  // Fractions whose parts fit in a long long take these paths: the products
+  // are formed in __int128, which cannot overflow for such parts, the gcds
+  // are word-sized, and the results go back into the inline limbs of num and
+  // denom, so nothing is allocated. A result that outgrows a long long is
+  // stored as it is and the next operation on it takes the general path.
+  bool ReadSmall(long long& small_num, long long& small_denom) const {
+    return num.ReadSmall(small_num) && denom.ReadSmall(small_denom) && small_denom > 0;
+  }
+
+  void AssignSmall(__int128 new_num, __int128 new_denom) {
+    num.AssignWide(new_num);
+    denom.AssignWide(new_denom);
+    ForgetHash();
+  }
+
+  // For reduced operands only gcd(b, d), and of that only the part shared
+  // with the new numerator, can cancel, so the result is reduced as well.
+  void AddSmall(long long a, long long b, long long c, long long d) {
+    long long gcd = BigInteger::BinaryGcd(b, d);
+    __int128 new_num = (__int128)a * (d / gcd) + (__int128)c * (b / gcd);
+    if (new_num == 0) {
+      AssignSmall(0, 1);
+      return;
+    }
+
+    unsigned __int128 magnitude = new_num < 0 ? -(unsigned __int128)new_num : new_num;
+    long long cancel = BigInteger::BinaryGcd((unsigned long long)(magnitude % gcd), gcd);
+    AssignSmall(new_num / cancel, (__int128)(b / gcd) * (d / cancel));
+  }
+
+  void MultiplySmall(long long a, long long b, long long c, long long d) {
+    if (a == 0 || c == 0) {
+      AssignSmall(0, 1);
+      return;
+    }
+
+    long long first_gcd = BigInteger::BinaryGcd(Magnitude(a), d);
+    long long second_gcd = BigInteger::BinaryGcd(Magnitude(c), b);
+    AssignSmall((__int128)(a / first_gcd) * (c / second_gcd),
+                (__int128)(b / second_gcd) * (d / first_gcd));
+  }
+
+  // Correctly rounded quotient of two magnitudes. The quotient is taken to
+  // about 60 bits and its lowest bit is forced on if the division was
+  // inexact, so the one rounding done by the conversion to double is the
+  // right one. Near the subnormal range the scale is capped and ldexp does
+  // the rounding instead.
+  static double RoundedQuotient(const Limbs& numerator, const Limbs& denominator) {
+    int scale = std::min(
+        60 - (int)std::floor(BigInteger::Log2Digits(numerator) - BigInteger::Log2Digits(denominator)),
+        1076);
+    BigInteger dividend = BigInteger::FromDigits(numerator);
+    BigInteger divisor = BigInteger::FromDigits(denominator);
+    BigInteger& scaled = scale >= 0 ? dividend : divisor;
+    int shift = std::abs(scale);
+    scaled *= shift < 63 ? BigInteger(1ull << shift) : BigInteger::Power(2, shift);
+
+    Limbs quotient;
+    Limbs remainder;
+    BigInteger::DivModDigits(dividend.digits_, divisor.digits_, quotient, remainder);
+    BigInteger::TrimDigits(remainder);
+
+    unsigned long long bits = 0;
+    for (int i = (int)quotient.size() - 1; i >= 0; --i) {
+      bits = bits * kBase + quotient[i];
+    }
+    bits |= remainder.empty() ? 0 : 1;
+    return std::ldexp((double)bits, -scale);
+  }
+
+  void Normalize() {
+    ForgetHash();
     if (denom < 0) {
-      num = -num;
-      denom = -denom;
+      num = -std::move(num);
+      denom = -std::move(denom);
+    }
+
+    if (num.digits_.size() >= kRationalNormalizeThreshold ||
+        denom.digits_.size() >= kRationalNormalizeThreshold) {
+      Reduce();
     }
   }
 
  public:
   Rational operator- () const {
-    Rational result{-num, denom};
+    Rational result = *this;
+    result.num = -std::move(result.num);
+    result.ForgetHash();
     return result;
   }
 
+  // The cross products are fused into the new numerator, so the only
+  // limb buffers allocated are the two results.
   Rational& operator+= (const Rational& second_frac) {
-    BigInteger new_num = num * second_frac.denom + denom * second_frac.num;
-    BigInteger new_denom = denom * second_frac.denom;
+    long long a = 0, b = 0, c = 0, d = 0;
+    if (ReadSmall(a, b) && second_frac.ReadSmall(c, d)) {
+      AddSmall(a, b, c, d);
+      return *this;
+    }
+
+    BigInteger new_num = BigIntegerProduct(num, second_frac.denom) +
+                         BigIntegerProduct(denom, second_frac.num);
+    denom *= second_frac.denom;
 
-    num = new_num;
-    denom = new_denom;
+    num = std::move(new_num);
     Normalize();
     return *this;
   }
 
   Rational& operator-= (const Rational& second_frac) {
-    *this += -second_frac;
+    long long a = 0, b = 0, c = 0, d = 0;
+    if (ReadSmall(a, b) && second_frac.ReadSmall(c, d)) {
+      AddSmall(a, b, -c, d);
+      return *this;
+    }
+
+    BigInteger new_num = BigIntegerProduct(num, second_frac.denom) -
+                         BigIntegerProduct(denom, second_frac.num);
+    denom *= second_frac.denom;
+
+    num = std::move(new_num);
+    Normalize();
     return *this;
   }
 
   Rational& operator*= (const Rational& second_frac) {
-    BigInteger new_num = num * second_frac.num;
-    BigInteger new_denom = denom * second_frac.denom;
+    long long a = 0, b = 0, c = 0, d = 0;
+    if (ReadSmall(a, b) && second_frac.ReadSmall(c, d)) {
+      MultiplySmall(a, b, c, d);
+      return *this;
+    }
 
-    num = new_num;
-    denom = new_denom;
+    num *= second_frac.num;
+    denom *= second_frac.denom;
     Normalize();
     return *this;
   }
 
   Rational& operator/= (const Rational& second_frac) {
-    BigInteger new_num = num * second_frac.denom;
-    BigInteger new_denom = denom * second_frac.num;
+    long long a = 0, b = 0, c = 0, d = 0;
+    if (ReadSmall(a, b) && second_frac.ReadSmall(c, d) && c != 0) {
+      MultiplySmall(a, b, c < 0 ? -d : d, Magnitude(c));
+      return *this;
+    }
+
+    BigInteger new_num = BigIntegerProduct(num, second_frac.denom);
+    denom *= second_frac.num;
 
-    num = new_num;
-    denom = new_denom;
+    num = std::move(new_num);
     Normalize();
     return *this;
   }
 
   Rational& operator= (const Rational& fraction) = default;
 
+  Rational& operator= (Rational&& fraction) = default;
+
+  // Hash of the reduced form, so fractions that compare equal hash equally.
+  // With BIGINTEGER_CACHE_HASH a repeated call returns the cached value.
+  size_t Hash() const {
+#ifdef BIGINTEGER_CACHE_HASH
+    if (size_t hash = hash_.Load(); hash != 0) {
+      return hash;
+    }
+#endif
+    Rational storage;
+    const Rational& reduced = ReducedForm(storage);
+    size_t hash = BigInteger::CombineHashes(reduced.num.Hash(), reduced.denom.Hash());
+#ifdef BIGINTEGER_CACHE_HASH
+    hash = hash_.Store(hash);
+#endif
+    return hash;
+  }
+
   std::string toString() const {
-    if (denom == 1) {
-      return num.toString();
+    Rational storage;
+    const Rational& reduced = ReducedForm(storage);
+    if (reduced.denom == 1) {
+      return reduced.num.toString();
     }
-    return num.toString() + "/" + denom.toString();
+    return reduced.num.toString() + "/" + reduced.denom.toString();
   }
 
   std::string asDecimal(size_t precision = 0) const {
-    BigInteger with_ten_power = num;
-
-    for (int i = 0; i < (int)precision; i++) {
-      with_ten_power *= 10;
-    }
+    BigInteger with_ten_power = num * BigInteger::Power(10, precision);
 
     std::string result = (with_ten_power / denom).toString();
     std::reverse(result.begin(), result.end());
@@ -502,8 +3910,219 @@ class Rational {
     return result;
   }
 
+  // Produces the partial quotients of the fraction and its convergents, each
+  // step costing one division of the two remaining parts:
+  //   Rational::Convergents convergents(value);
+  //   for (Rational convergent; convergents.Next(convergent);) ...
+  // The quotients are floored, so only the first one can be negative, and
+  // the last convergent is the fraction itself.
+  class Convergents {
+   private:
+    friend class Rational;
+
+    BigInteger numerator_;
+    BigInteger denominator_;
+    BigInteger term_ = 0;
+    BigInteger current_num_ = 1;
+    BigInteger current_denom_ = 0;
+    BigInteger previous_num_ = 0;
+    BigInteger previous_denom_ = 1;
+
+    bool NextTerm() {
+      if (!denominator_) {
+        return false;
+      }
+
+      BigInteger remainder;
+      DivMod(numerator_, denominator_, term_, remainder);
+      if (remainder < 0) {
+        --term_;
+        remainder += denominator_;
+      }
+      numerator_ = std::move(denominator_);
+      denominator_ = std::move(remainder);
+      return true;
+    }
+
+   public:
+    explicit Convergents(const Rational& value) : numerator_(value.num), denominator_(value.denom) {}
+
+    // Consecutive convergents differ by 1 / (q_k q_(k-1)), so each of them
+    // is already reduced.
+    bool Next(Rational& convergent) {
+      if (!NextTerm()) {
+        return false;
+      }
+
+      BigInteger next_num = term_ * current_num_ + previous_num_;
+      BigInteger next_denom = term_ * current_denom_ + previous_denom_;
+      previous_num_ = std::move(current_num_);
+      previous_denom_ = std::move(current_denom_);
+      current_num_ = std::move(next_num);
+      current_denom_ = std::move(next_denom);
+
+      convergent.num = current_num_;
+      convergent.denom = current_denom_;
+      convergent.ForgetHash();
+      return true;
+    }
+
+    // The partial quotient behind the last convergent.
+    const BigInteger& Term() const {
+      return term_;
+    }
+  };
+
+  std::vector<BigInteger> ContinuedFraction() const {
+    std::vector<BigInteger> terms;
+    Convergents convergents(*this);
+    while (convergents.NextTerm()) {
+      terms.push_back(convergents.term_);
+    }
+    return terms;
+  }
+
+  // The closest fraction with a denominator of at most max_denominator. It
+  // is either the last convergent that fits or the largest semiconvergent
+  // between the one before it and the first that does not fit.
+  Rational BestApproximation(const BigInteger& max_denominator) const {
+    if (max_denominator < 1) {
+      throw std::invalid_argument("Rational: maximum denominator must be positive");
+    }
+
+    Convergents convergents(*this);
+    Rational convergent;
+    while (convergents.Next(convergent)) {
+      if (convergent.denom <= max_denominator) {
+        continue;
+      }
+
+      const BigInteger& last_num = convergents.previous_num_;
+      const BigInteger& last_denom = convergents.previous_denom_;
+      BigInteger before_num = convergent.num - convergents.term_ * last_num;
+      BigInteger before_denom = convergent.denom - convergents.term_ * last_denom;
+      BigInteger steps = (max_denominator - before_denom) / last_denom;
+
+      // Semiconvergents are reduced for the same reason as convergents.
+      Rational last;
+      last.num = last_num;
+      last.denom = last_denom;
+      Rational semiconvergent;
+      semiconvergent.num = before_num + steps * last_num;
+      semiconvergent.denom = before_denom + steps * last_denom;
+
+      Rational last_error = last;
+      Rational semiconvergent_error = semiconvergent;
+      last_error -= *this;
+      semiconvergent_error -= *this;
+      if (last_error < 0) {
+        last_error = -last_error;
+      }
+      if (semiconvergent_error < 0) {
+        semiconvergent_error = -semiconvergent_error;
+      }
+      return semiconvergent_error < last_error ? semiconvergent : last;
+    }
+    return convergent;
+  }
+
+  // Keeps the top kRationalToDoubleLimbs limbs of each part, which pins the
+  // value between two close bounds. Only when those round to different
+  // doubles is the exact quotient needed.
   explicit operator double() const {
-    return std::stod(asDecimal(kRationalToDoublePrecision));
+    if (!num) {
+      return 0;
+    }
+
+    const Limbs& num_digits = num.digits_;
+    const Limbs& denom_digits = denom.digits_;
+    double sign = num < 0 ? -1 : 1;
+    size_t num_dropped = num_digits.size() - std::min(num_digits.size(), kRationalToDoubleLimbs);
+    size_t denom_dropped = denom_digits.size() - std::min(denom_digits.size(), kRationalToDoubleLimbs);
+    if (num_dropped == 0 && denom_dropped == 0) {
+      return sign * RoundedQuotient(num_digits, denom_digits);
+    }
+
+    double scale_bits = ((double)num_dropped - (double)denom_dropped) * std::log2((double)kBase);
+    if (scale_bits > 1100) {
+      return sign * HUGE_VAL;
+    }
+    if (scale_bits < -1200) {
+      return sign * 0.0;
+    }
+
+    BigInteger num_low = BigInteger::FromDigits(
+        BigInteger::SliceDigits(num_digits, num_dropped, num_digits.size()));
+    BigInteger denom_low = BigInteger::FromDigits(
+        BigInteger::SliceDigits(denom_digits, denom_dropped, denom_digits.size()));
+    BigInteger num_high = num_low + (num_dropped > 0 ? 1 : 0);
+    BigInteger denom_high = denom_low + (denom_dropped > 0 ? 1 : 0);
+
+    size_t shift = std::min(num_dropped, denom_dropped);
+    num_dropped -= shift;
+    denom_dropped -= shift;
+    for (BigInteger* part : {&num_low, &num_high}) {
+      part->digits_ = BigInteger::ShiftDigits(part->digits_, num_dropped);
+    }
+    for (BigInteger* part : {&denom_low, &denom_high}) {
+      part->digits_ = BigInteger::ShiftDigits(part->digits_, denom_dropped);
+    }
+
+    double lower = RoundedQuotient(num_low.digits_, denom_high.digits_);
+    double upper = RoundedQuotient(num_high.digits_, denom_low.digits_);
+    if (lower == upper) {
+      return sign * lower;
+    }
+    return sign * RoundedQuotient(num_digits, denom_digits);
+  }
+
+  // The numerator's binary encoding followed by the denominator's, as they
+  // are stored; the fraction is not reduced first.
+  size_t SerializedSize() const {
+    return num.SerializedSize() + denom.SerializedSize();
+  }
+
+  std::to_chars_result Serialize(char* first, char* last) const {
+    std::to_chars_result written = num.Serialize(first, last);
+    if (written.ec != std::errc{}) {
+      return written;
+    }
+    return denom.Serialize(written.ptr, last);
+  }
+
+  // Reuses the storage of value's parts; value is left zero on failure.
+  static std::from_chars_result Deserialize(const char* first, const char* last, Rational& value) {
+    std::from_chars_result read = BigInteger::Deserialize(first, last, value.num);
+    if (read.ec == std::errc{}) {
+      read = BigInteger::Deserialize(read.ptr, last, value.denom);
+    }
+
+    value.ForgetHash();
+    if (read.ec != std::errc{} || value.denom <= 0) {
+      value.num = 0;
+      value.denom = 1;
+      return {first, std::errc::invalid_argument};
+    }
+    value.Normalize();
+    return read;
+  }
+
+  void WriteBinary(std::ostream& output) const {
+    num.WriteBinary(output);
+    denom.WriteBinary(output);
+  }
+
+  static std::istream& ReadBinary(std::istream& input, Rational& value) {
+    value.ForgetHash();
+    if (!BigInteger::ReadBinary(input, value.num) || !BigInteger::ReadBinary(input, value.denom) ||
+        value.denom <= 0) {
+      value.num = 0;
+      value.denom = 1;
+      input.setstate(std::ios::failbit);
+    } else {
+      value.Normalize();
+    }
+    return input;
   }
 
   Rational() {}
@@ -522,6 +4141,8 @@ class Rational {
 
   Rational(const Rational& fraction) = default;
 
+  Rational(Rational&& fraction) = default;
+
   friend bool operator== (const Rational& first_frac, const Rational& second_frac);
   friend bool operator< (const Rational& first_frac, const Rational& second_frac);
 };
@@ -551,7 +4172,16 @@ Rational operator/ (const Rational& first_frac, const Rational& second_frac) {
 }
 
 bool operator== (const Rational& first_frac, const Rational& second_frac) {
-  return first_frac.num == second_frac.num && first_frac.denom == second_frac.denom;
+  long long a = 0, b = 0, c = 0, d = 0;
+  if (first_frac.ReadSmall(a, b) && second_frac.ReadSmall(c, d)) {
+    return (__int128)a * d == (__int128)c * b;
+  }
+
+  if (kRationalNormalizeThreshold == 0) {
+    return first_frac.num == second_frac.num && first_frac.denom == second_frac.denom;
+  }
+  return BigIntegerProduct(first_frac.num, second_frac.denom) -
+         BigIntegerProduct(first_frac.denom, second_frac.num) == 0;
 }
 
 bool operator!= (const Rational& first_frac, const Rational& second_frac) {
@@ -559,7 +4189,13 @@ bool operator!= (const Rational& first_frac, const Rational& second_frac) {
 }
 
 bool operator< (const Rational& first_frac, const Rational& second_frac) {
-  return first_frac.num * second_frac.denom < first_frac.denom * second_frac.num;
+  long long a = 0, b = 0, c = 0, d = 0;
+  if (first_frac.ReadSmall(a, b) && second_frac.ReadSmall(c, d)) {
+    return (__int128)a * d < (__int128)c * b;
+  }
+
+  return BigIntegerProduct(first_frac.num, second_frac.denom) -
+         BigIntegerProduct(first_frac.denom, second_frac.num) < 0;
 }
 
 bool operator> (const Rational& first_frac, const Rational& second_frac) {
@@ -578,3 +4214,17 @@ std::ostream& operator<< (std::ostream& output_stream, const Rational& num) {
   output_stream << num.toString();
   return output_stream;
 }
+
+template <>
+struct std::hash<BigInteger> {
+  size_t operator()(const BigInteger& value) const {
+    return value.Hash();
+  }
+};
+
+template <>
+struct std::hash<Rational> {
+  size_t operator()(const Rational& value) const {
+    return value.Hash();
+  }
+};
@@ -0,0 +1,283 @@
+// Measures BigInteger and Rational arithmetic over a sweep of operand sizes.
+//
+//   g++ -std=c++20 -O2 -pthread biginteger_benchmark.cpp -o biginteger_benchmark
+//   ./biginteger_benchmark [--max-limbs N] [--min-time SECONDS] [--filter NAME]
+//                          [--no-op-limits] [--csv FILE] [--json FILE]
+//
+// Sizes are counted in limbs of the configured radix. Operations that are
+// still quadratic somewhere stop at their own size limit unless
+// --no-op-limits is given.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "biginteger.h"
+
+// Worker threads of the parallel tiers allocate too, and their allocations
+// are counted with the caller's.
+std::atomic<size_t> allocation_count{0};
+volatile size_t benchmark_sink = 0;
+
+// GCC inlines a one-line delete into callers whose operator new it keeps
+// out of line and then reports free() on memory from operator new, so the
+// deletes stay out of line.
+#if defined(__GNUC__)
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#else
+#define BENCHMARK_NOINLINE
+#endif
+
+void* operator new(size_t n) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void* pointer = std::malloc(n);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new[](size_t n) {
+  return operator new(n);
+}
+
+BENCHMARK_NOINLINE void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+BENCHMARK_NOINLINE void operator delete(void* pointer, size_t) noexcept {
+  std::free(pointer);
+}
+
+BENCHMARK_NOINLINE void operator delete[](void* pointer) noexcept {
+  std::free(pointer);
+}
+
+BENCHMARK_NOINLINE void operator delete[](void* pointer, size_t) noexcept {
+  std::free(pointer);
+}
+
+namespace {
+
+struct Operands {
+  BigInteger first;
+  BigInteger second;
+  BigInteger half;
+  std::string first_string;
+  Rational first_fraction;
+  Rational second_fraction;
+};
+
+struct Operation {
+  std::string name;
+  size_t max_limbs;
+  bool is_rational;
+  std::function<size_t(const Operands&)> run;
+};
+
+struct Result {
+  std::string name;
+  size_t limbs;
+  double ns_per_op;
+  double allocations_per_op;
+  size_t iterations;
+};
+
+std::string RandomDecimal(std::mt19937_64& rng, size_t limbs) {
+  size_t length = std::max<size_t>(1, (size_t)std::ceil(limbs * std::log10((double)kBase)));
+  std::string result(length, '0');
+  result[0] = char('1' + rng() % 9);
+  for (size_t i = 1; i < length; ++i) {
+    result[i] = char('0' + rng() % 10);
+  }
+  return result;
+}
+
+// Building the fractions already costs a gcd, so it is skipped for sizes no
+// Rational operation is going to run at.
+Operands MakeOperands(std::mt19937_64& rng, size_t limbs, bool with_fractions) {
+  Operands operands;
+  operands.first_string = RandomDecimal(rng, limbs);
+  operands.first = BigInteger(operands.first_string);
+  operands.second = BigInteger(RandomDecimal(rng, limbs));
+  operands.half = BigInteger(RandomDecimal(rng, std::max<size_t>(1, limbs / 2)));
+  if (with_fractions) {
+    operands.first_fraction = Rational(operands.first, operands.half + 1);
+    operands.second_fraction = Rational(operands.second, operands.half + 3);
+  }
+  return operands;
+}
+
+std::vector<Operation> MakeOperations() {
+  return {
+      {"add", 1000000, false, [](const Operands& operands) {
+         return (size_t)(bool)(operands.first + operands.second);
+       }},
+      {"sub", 1000000, false, [](const Operands& operands) {
+         return (size_t)(bool)(operands.first - operands.second);
+       }},
+      {"mul", 1000000, false, [](const Operands& operands) {
+         return (size_t)(bool)(operands.first * operands.second);
+       }},
+      {"div", 1000000, false, [](const Operands& operands) {
+         return (size_t)(bool)(operands.first / operands.half);
+       }},
+      {"mod", 1000000, false, [](const Operands& operands) {
+         return (size_t)(bool)(operands.first % operands.half);
+       }},
+      {"gcd", 10000, false, [](const Operands& operands) {
+         return (size_t)(bool)Gcd(operands.first, operands.second);
+       }},
+      {"to_string", 1000000, false, [](const Operands& operands) {
+         return operands.first.toString().size();
+       }},
+      {"parse", 1000000, false, [](const Operands& operands) {
+         return (size_t)(bool)BigInteger(operands.first_string);
+       }},
+      {"rational_add", 1000, true, [](const Operands& operands) {
+         Rational result = operands.first_fraction;
+         result += operands.second_fraction;
+         return (size_t)(result != 0);
+       }},
+      {"rational_mul", 1000, true, [](const Operands& operands) {
+         Rational result = operands.first_fraction;
+         result *= operands.second_fraction;
+         return (size_t)(result != 0);
+       }},
+      {"best_approximation", 1000, true, [](const Operands& operands) {
+         return (size_t)(operands.first_fraction.BestApproximation(operands.half / 7 + 1) != 0);
+       }},
+      {"as_decimal", 10000, true, [](const Operands& operands) {
+         return operands.first_fraction.asDecimal(20).size();
+       }},
+      {"to_double", 1000000, true, [](const Operands& operands) {
+         return (size_t)((double)operands.first_fraction != 0);
+       }},
+  };
+}
+
+Result Measure(const Operation& operation, const Operands& operands, size_t limbs,
+               double min_time) {
+  size_t sink = 0;
+  size_t iterations = 0;
+  size_t allocations_before = allocation_count;
+  auto start = std::chrono::steady_clock::now();
+  double elapsed = 0;
+
+  do {
+    sink += operation.run(operands);
+    ++iterations;
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (elapsed < min_time);
+
+  size_t allocations = allocation_count - allocations_before;
+  benchmark_sink = benchmark_sink + sink;
+
+  return {operation.name, limbs, elapsed * 1e9 / iterations,
+          (double)allocations / iterations, iterations};
+}
+
+void WriteCsv(const std::string& path, const std::vector<Result>& results) {
+  std::ofstream output(path);
+  output << "operation,limbs,ns_per_op,allocations_per_op,iterations\n";
+  for (const Result& result : results) {
+    output << result.name << ',' << result.limbs << ',' << std::fixed << std::setprecision(1)
+           << result.ns_per_op << ',' << std::setprecision(2) << result.allocations_per_op << ','
+           << result.iterations << '\n';
+  }
+}
+
+void WriteJson(const std::string& path, const std::vector<Result>& results) {
+  std::ofstream output(path);
+  output << "[\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& result = results[i];
+    output << "  {\"operation\": \"" << result.name << "\", \"limbs\": " << result.limbs
+           << ", \"ns_per_op\": " << std::fixed << std::setprecision(1) << result.ns_per_op
+           << ", \"allocations_per_op\": " << std::setprecision(2) << result.allocations_per_op
+           << ", \"iterations\": " << result.iterations << "}"
+           << (i + 1 == results.size() ? "\n" : ",\n");
+  }
+  output << "]\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t max_limbs = 1000000;
+  double min_time = 0.2;
+  bool op_limits = true;
+  std::string filter;
+  std::string csv_path;
+  std::string json_path;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    bool has_value = i + 1 < argc;
+    if (argument == "--max-limbs" && has_value) {
+      max_limbs = std::stoull(argv[++i]);
+    } else if (argument == "--min-time" && has_value) {
+      min_time = std::stod(argv[++i]);
+    } else if (argument == "--filter" && has_value) {
+      filter = argv[++i];
+    } else if (argument == "--csv" && has_value) {
+      csv_path = argv[++i];
+    } else if (argument == "--json" && has_value) {
+      json_path = argv[++i];
+    } else if (argument == "--no-op-limits") {
+      op_limits = false;
+    } else {
+      std::cerr << "unknown argument: " << argument << '\n';
+      return 1;
+    }
+  }
+
+  std::vector<Operation> operations = MakeOperations();
+  std::vector<Result> results;
+  std::mt19937_64 rng(2024);
+
+  std::cout << std::left << std::setw(14) << "operation" << std::right << std::setw(10) << "limbs"
+            << std::setw(18) << "ns/op" << std::setw(14) << "allocs/op" << std::setw(12)
+            << "iterations" << '\n';
+
+  auto skipped = [&](const Operation& operation, size_t limbs) {
+    return (!filter.empty() && operation.name != filter) ||
+           (op_limits && limbs > operation.max_limbs);
+  };
+
+  for (size_t limbs = 1; limbs <= max_limbs; limbs *= 10) {
+    bool with_fractions = false;
+    for (const Operation& operation : operations) {
+      with_fractions |= operation.is_rational && !skipped(operation, limbs);
+    }
+    Operands operands = MakeOperands(rng, limbs, with_fractions);
+
+    for (const Operation& operation : operations) {
+      if (skipped(operation, limbs)) {
+        continue;
+      }
+
+      Result result = Measure(operation, operands, limbs, min_time);
+      results.push_back(result);
+      std::cout << std::left << std::setw(14) << result.name << std::right << std::setw(10)
+                << result.limbs << std::setw(18) << std::fixed << std::setprecision(1)
+                << result.ns_per_op << std::setw(14) << std::setprecision(2)
+                << result.allocations_per_op << std::setw(12) << result.iterations << std::endl;
+    }
+  }
+
+  if (!csv_path.empty()) {
+    WriteCsv(csv_path, results);
+  }
+  if (!json_path.empty()) {
+    WriteJson(json_path, results);
+  }
+}
@@ -0,0 +1,1101 @@
+// Tests for biginteger.h. The limb radix and the optional code paths are
+// fixed at compile time, so the tests are built once for each:
+//
+//   g++ -std=c++20 -O2 -pthread biginteger_test.cpp -o biginteger_test
+//   g++ -std=c++20 -O2 -pthread -DBIGINTEGER_BINARY_RADIX biginteger_test.cpp -o biginteger_test
+//   g++ -std=c++20 -O1 -pthread -fsanitize=thread -DBIGINTEGER_CACHE_HASH biginteger_test.cpp -o biginteger_test
+
+#include <cassert>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "biginteger.h"
+
+thread_local int new_called = 0;
+
+void* operator new(size_t n) {
+  ++new_called;
+  return std::malloc(n);
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+std::string RandomDigits(std::mt19937& rng, size_t length) {
+  std::string result(1, char('1' + rng() % 9));
+  while (result.size() < length) {
+    result.push_back(char('0' + rng() % 10));
+  }
+  return result;
+}
+
+// Limbs of a decimal string in the given radix, by long division of the
+// digits, so that nothing in biginteger.h takes part.
+std::vector<long long> LimbsOf(const std::string& digits, long long radix) {
+  std::vector<int> remaining;
+  for (char digit : digits) {
+    remaining.push_back(digit - '0');
+  }
+
+  std::vector<long long> limbs;
+  while (!remaining.empty()) {
+    std::vector<int> quotient;
+    long long remainder = 0;
+    for (int digit : remaining) {
+      remainder = remainder * 10 + digit;
+      if (!quotient.empty() || remainder >= radix) {
+        quotient.push_back((int)(remainder / radix));
+      }
+      remainder %= radix;
+    }
+    limbs.push_back(remainder);
+    remaining = std::move(quotient);
+  }
+  return limbs;
+}
+
+// Serialized form of a nonnegative value with more than two limbs, which
+// Serialize always writes in the limb layout.
+std::string EncodeLimbs(const std::vector<long long>& limbs, BinaryLayout layout) {
+  std::string encoded(1, char(kBinaryFormatVersion << 4 | layout));
+  unsigned long long header = limbs.size() << 1;
+  for (; header >= 0x80; header >>= 7) {
+    encoded.push_back(char((header & 0x7F) | 0x80));
+  }
+  encoded.push_back(char(header));
+  for (long long limb : limbs) {
+    for (int byte = 0; byte < 4; ++byte) {
+      encoded.push_back(char((limb >> (8 * byte)) & 0xFF));
+    }
+  }
+  return encoded;
+}
+
+// Decimal digits of 2^exponent + offset, for a small offset.
+std::string PowerOfTwoDigits(int exponent, int offset) {
+  std::string digits = "1";
+  for (int i = 0; i < exponent; ++i) {
+    int carry = 0;
+    for (int j = (int)digits.size() - 1; j >= 0; --j) {
+      int doubled = 2 * (digits[j] - '0') + carry;
+      digits[j] = char('0' + doubled % 10);
+      carry = doubled / 10;
+    }
+    if (carry != 0) {
+      digits.insert(digits.begin(), '1');
+    }
+  }
+
+  int last = digits.back() - '0' + offset;
+  assert(0 <= last && last <= 9);
+  digits.back() = char('0' + last);
+  return digits;
+}
+
+void TestMultiplicationNines() {
+  for (size_t length : {1, 9, 10, 100, 500, 4000, 20000}) {
+    BigInteger nines(std::string(length, '9'));
+    std::string expected = std::string(length - 1, '9') + "8" +
+                           std::string(length - 1, '0') + "1";
+    assert((nines * nines).toString() == expected);
+    assert((nines * -nines).toString() == "-" + expected);
+  }
+}
+
+void TestMultiplicationIdentities() {
+  std::mt19937 rng(42);
+  for (size_t length : {5, 50, 400, 3000, 12000}) {
+    BigInteger first(RandomDigits(rng, length));
+    BigInteger second(RandomDigits(rng, length / 3 + 1));
+    BigInteger third(RandomDigits(rng, length));
+
+    assert(first * second == second * first);
+    assert((first + second) * (first - second) == first * first - second * second);
+    assert(first * (second + third) == first * second + first * third);
+    assert(first * 0 == 0);
+    assert(-first * -third == first * third);
+  }
+}
+
+void TestHugeMultiplication() {
+  std::mt19937 rng(7);
+  BigInteger first(RandomDigits(rng, 200000));
+  BigInteger second(RandomDigits(rng, 150000));
+  BigInteger third(RandomDigits(rng, 90000));
+
+  assert((first + second) * third == first * third + second * third);
+
+  BigInteger square = first;
+  square *= square;
+  assert(square == first * BigInteger(first));
+
+  BigInteger nines(std::string(100000, '9'));
+  nines *= nines;
+  assert(nines.toString() == std::string(99999, '9') + "8" + std::string(99999, '0') + "1");
+}
+
+void TestDivision() {
+  std::mt19937 rng(13);
+  for (size_t length : {1, 8, 9, 10, 40, 300, 2000}) {
+    for (size_t divisor_length : {1, 9, 10, 30, 500}) {
+      BigInteger dividend(RandomDigits(rng, length + divisor_length));
+      BigInteger divisor(RandomDigits(rng, divisor_length));
+
+      for (int sign = 0; sign < 4; ++sign) {
+        BigInteger first = sign & 1 ? -dividend : dividend;
+        BigInteger second = sign & 2 ? -divisor : divisor;
+        BigInteger quotient = first / second;
+        BigInteger remainder = first % second;
+
+        assert(quotient * second + remainder == first);
+        assert(remainder == 0 || (remainder < 0) == (first < 0));
+        assert((remainder < 0 ? -remainder : remainder) < divisor);
+      }
+    }
+  }
+
+  BigInteger power_of_base("1000000000000000000000000000");
+  assert(power_of_base / BigInteger("999999999999999999") == 1000000000);
+  assert(power_of_base % BigInteger("999999999999999999") == 1000000000);
+  assert(BigInteger(17) / BigInteger("100000000000000000000") == 0);
+  assert(BigInteger(-17) % 5 == -2);
+}
+
+void TestLargeDivision() {
+  std::mt19937 rng(17);
+  BigInteger divisor(RandomDigits(rng, 20000));
+  BigInteger quotient(RandomDigits(rng, 35000));
+  BigInteger remainder(RandomDigits(rng, 19000));
+  BigInteger dividend = quotient * divisor + remainder;
+
+  assert(dividend / divisor == quotient);
+  assert(dividend % divisor == remainder);
+  assert(-dividend / divisor == -quotient);
+
+  BigIntegerReciprocal reciprocal(divisor);
+  assert(reciprocal.Divide(dividend) == quotient);
+  assert(reciprocal.Modulo(dividend) == remainder);
+  assert(reciprocal.Modulo(-dividend) == -remainder);
+
+  BigIntegerReciprocal small_reciprocal(BigInteger(-7));
+  for (int value : {0, 1, 6, 7, 50, -50, 1000000007}) {
+    assert(small_reciprocal.Divide(value) == value / -7);
+    assert(small_reciprocal.Modulo(value) == value % -7);
+  }
+}
+
+void TestDecimalConversion() {
+  std::mt19937 rng(19);
+  for (size_t length : {1, 9, 10, 17, 18, 19, 500, 5000, 300000}) {
+    std::string digits = RandomDigits(rng, length);
+    assert(BigInteger(digits).toString() == digits);
+    assert(BigInteger("-" + digits).toString() == "-" + digits);
+  }
+
+  std::string padded = "1" + std::string(4000, '0') + "1";
+  assert(BigInteger(padded).toString() == padded);
+  assert(BigInteger("000000000000000000042").toString() == "42");
+  assert(BigInteger("-0").toString() == "0");
+  assert(BigInteger("+0") == 0 && BigInteger("+" + padded).toString() == padded);
+
+  BigInteger value;
+  const char text[] = "-12345678901234567890xyz";
+  std::from_chars_result parsed = BigInteger::FromChars(text, text + sizeof(text) - 1, value);
+  assert(parsed.ec == std::errc{} && *parsed.ptr == 'x');
+  assert(value == BigInteger("-12345678901234567890"));
+  assert(BigInteger::FromChars(text + 21, text + 24, value).ec == std::errc::invalid_argument);
+
+  char buffer[21];
+  std::to_chars_result written = value.ToChars(buffer, buffer + sizeof(buffer));
+  assert(written.ec == std::errc{} && std::string(buffer, written.ptr) == "-12345678901234567890");
+  assert(value.ToChars(buffer, buffer + 20).ec == std::errc::value_too_large);
+
+  for (const char* invalid : {"12a", "+", "-", "+-1", "--1", ""}) {
+    bool thrown = false;
+    try {
+      BigInteger{std::string(invalid)};
+    } catch (std::invalid_argument&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+}
+
+void TestWordSizedArithmeticDoesNotAllocate() {
+  BigInteger first = 123456789;
+  BigInteger second(987654321987654321ull);
+  BigInteger third = -77;
+
+  int allocations_before = new_called;
+  for (int i = 0; i < 100; ++i) {
+    BigInteger result = first + second;
+    result -= third;
+    result *= third;
+    result /= first;
+    result %= second;
+    result = -result + second * first;
+    ++result;
+    assert(result > third);
+  }
+  assert(new_called == allocations_before);
+}
+
+void TestInPlaceAddition() {
+  std::mt19937 rng(23);
+  BigInteger first(RandomDigits(rng, 900));
+  BigInteger second(RandomDigits(rng, 1000));
+  BigInteger third(RandomDigits(rng, 800));
+  BigInteger fourth(RandomDigits(rng, 950));
+
+  int allocations_before = new_called;
+  BigInteger sum = first + second + third + fourth;
+  assert(new_called - allocations_before <= 2);
+
+  allocations_before = new_called;
+  BigInteger difference = first - second - third - fourth;
+  assert(new_called - allocations_before <= 2);
+  assert(sum + difference == first + first);
+
+  allocations_before = new_called;
+  sum -= fourth;
+  sum += -std::move(difference);
+  assert(new_called == allocations_before);
+  assert(sum == second * 2 + third * 2 + fourth);
+
+  BigInteger twice = first;
+  twice += twice;
+  assert(twice == first * 2);
+  twice -= twice;
+  assert(twice == 0 && twice.toString() == "0");
+  assert(first - first == 0);
+  assert((-first + first).toString() == "0");
+}
+
+void TestGcd() {
+  assert(Gcd(BigInteger(0), BigInteger(0)) == 0);
+  assert(Gcd(BigInteger(-12), BigInteger(18)) == 6);
+  assert(Gcd(BigInteger(-12), BigInteger(0)) == 12);
+
+  BigInteger previous = 1;
+  BigInteger current = 1;
+  for (int i = 0; i < 3000; ++i) {
+    BigInteger next = previous + current;
+    previous = std::move(current);
+    current = std::move(next);
+  }
+  assert(Gcd(current, previous) == 1);
+
+  std::mt19937 rng(29);
+  BigInteger common(RandomDigits(rng, 3000));
+  BigInteger first = common * BigInteger(RandomDigits(rng, 4000));
+  BigInteger second = common * BigInteger(RandomDigits(rng, 2000));
+  BigInteger gcd = Gcd(first, second);
+  assert(gcd % common == 0);
+  assert(Gcd(first / gcd, second / gcd) == 1);
+}
+
+void TestRationalNormalization() {
+  Rational telescoping = 0;
+  for (int k = 1; k <= 200; ++k) {
+    telescoping += Rational(1, k * (k + 1));
+  }
+  assert(telescoping == Rational(200, 201));
+  assert(telescoping.toString() == "200/201");
+
+  Rational product = 1;
+  for (int k = 1; k <= 100; ++k) {
+    product *= Rational(k + 1, -k);
+  }
+  assert(product == 101);
+  assert(product.toString() == "101");
+  assert((product / Rational(-202, 4)).toString() == "-2");
+  assert(Rational(3, -6) < Rational(1, 3));
+  assert(Rational(-6, -4).asDecimal(2) == "1.50");
+
+  std::string unreduced(BigInteger(-6).SerializedSize() + BigInteger(4).SerializedSize(), '\0');
+  char* end = BigInteger(-6).Serialize(unreduced.data(), unreduced.data() + unreduced.size()).ptr;
+  BigInteger(4).Serialize(end, unreduced.data() + unreduced.size());
+  Rational read;
+  Rational::Deserialize(unreduced.data(), unreduced.data() + unreduced.size(), read);
+  assert(read == Rational(-3, 2) && read.toString() == "-3/2");
+
+  std::mt19937 rng(79);
+  Rational shared(BigInteger(RandomDigits(rng, 300)) * 6, BigInteger(RandomDigits(rng, 300)) * 4);
+  Rational copy = shared;
+  std::string shared_string;
+  std::thread reader([&] { shared_string = shared.toString(); });
+  bool equal = shared == copy && shared.Hash() == copy.Hash();
+  reader.join();
+  assert(equal && shared_string == copy.toString());
+}
+
+void TestModularArithmetic() {
+  BigInteger mersenne("170141183460469231731687303715884105727");
+  MontgomeryContext montgomery(mersenne);
+  for (int base : {2, 3, 10, -7, 123456789}) {
+    assert(montgomery.PowMod(base, mersenne - 1) == 1);
+    assert(PowMod(base, mersenne - 1, mersenne) == 1);
+  }
+  assert(montgomery.PowMod(5, 0) == 1);
+
+  std::mt19937 rng(31);
+  BigInteger modulus = BigInteger(RandomDigits(rng, 700)) * 10 + 3;
+  BigInteger first(RandomDigits(rng, 900));
+  BigInteger second(RandomDigits(rng, 650));
+  MontgomeryContext big_montgomery(modulus);
+  assert(big_montgomery.MulMod(first, second) == first * second % modulus);
+  assert(big_montgomery.SqrMod(-first) == first * first % modulus);
+
+  BigInteger even_modulus = BigInteger(RandomDigits(rng, 300)) * 10;
+  BarrettContext barrett(even_modulus);
+  assert(barrett.MulMod(first, second) == first * second % even_modulus);
+  assert(barrett.SqrMod(second) == second * second % even_modulus);
+
+  BigInteger power = 1;
+  for (int i = 0; i < 77; ++i) {
+    power = power * first % even_modulus;
+  }
+  assert(barrett.PowMod(first, 77) == power);
+  assert(PowMod(first, 77, even_modulus) == power);
+
+  bool thrown = false;
+  try {
+    MontgomeryContext invalid(even_modulus);
+  } catch (std::invalid_argument&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void TestProductTree() {
+  BigInteger factorial = 1;
+  for (int i = 2; i <= 3000; ++i) {
+    factorial *= i;
+  }
+  assert(Factorial(3000) == factorial);
+  assert(Factorial(3000, true) == factorial);
+  assert(Factorial(0) == 1 && Factorial(1) == 1 && Factorial(20) == BigInteger(2432902008176640000ull));
+
+  assert(Binomial(100, 50) == BigInteger("100891344545564193334812497256"));
+  assert(Binomial(100, 0) == 1 && Binomial(100, 100) == 1 && Binomial(5, 7) == 0);
+  assert(Binomial(4000, 1300, true) * Factorial(1300) * Factorial(2700) == Factorial(4000));
+
+  std::vector<int> factors = {3, -5, 7, 11, -13};
+  assert(Product(factors.begin(), factors.end()) == 15015);
+  assert(Product(factors.begin(), factors.begin()) == 1);
+  assert(RangeProduct(0, 5) == 0 && RangeProduct(7, 6) == 1);
+
+  std::mt19937 rng(37);
+  std::vector<BigInteger> moduli;
+  for (size_t i = 0; i < 37; ++i) {
+    moduli.emplace_back(RandomDigits(rng, 1 + rng() % 300));
+  }
+  BigInteger value = -BigInteger(RandomDigits(rng, 6000));
+  std::vector<BigInteger> remainders = RemainderTree(value, moduli);
+  std::vector<BigInteger> parallel_remainders = RemainderTree(value, moduli, true);
+  for (size_t i = 0; i < moduli.size(); ++i) {
+    assert(remainders[i] == value % moduli[i]);
+    assert(parallel_remainders[i] == remainders[i]);
+  }
+}
+
+void TestThreadedArithmetic() {
+  std::mt19937 rng(41);
+  BigInteger first(RandomDigits(rng, 400000));
+  BigInteger second(RandomDigits(rng, 200000));
+
+  BigInteger product = first * second;
+  BigInteger quotient = first / second;
+  BigInteger remainder = first % second;
+
+  SetThreadCount(4);
+  assert(ThreadCount() == 4);
+  assert(first * second == product);
+  assert(first / second == quotient);
+  assert(first % second == remainder);
+  assert(quotient * second + remainder == first);
+
+  SetThreadCount(0);
+  assert(ThreadCount() == 1);
+
+  std::string product_string;
+  std::string first_string;
+  std::thread converter([&] { product_string = product.toString(); });
+  first_string = first.toString();
+  converter.join();
+  assert(BigInteger(product_string) == product && BigInteger(first_string) == first);
+}
+
+// The dispatching kernels, and the AVX2 ones directly where the CPU has
+// them, must agree with the scalar loops for every length, including tails
+// that do not fill a vector, and for the extreme factors the contract allows.
+void TestLimbKernels() {
+  std::mt19937 rng(67);
+  const long long factors[] = {0, 1, -1, kBase - 1, -(kBase - 1), INT32_MAX, INT32_MIN};
+  for (size_t size = 0; size <= 41; ++size) {
+    std::vector<long long> source(size);
+    std::vector<long long> target(size);
+    for (size_t i = 0; i < size; ++i) {
+      source[i] = i % 5 == 0 ? kBase - 1 : rng() % kBase;
+      target[i] = (long long)(rng() % kBase) - kBase / 2;
+    }
+
+    for (long long factor : factors) {
+      std::vector<long long> expected = target;
+      AccumulateScaledScalar(expected.data(), source.data(), size, factor);
+      std::vector<long long> result = target;
+      AccumulateScaled(result.data(), source.data(), size, factor);
+      assert(result == expected);
+#ifdef BIGINTEGER_AVX2_KERNELS
+      if (HasAvx2()) {
+        result = target;
+        AccumulateScaledAvx2(result.data(), source.data(), size, factor);
+        assert(result == expected);
+      }
+#endif
+    }
+
+    std::vector<long long> copy = source;
+    assert(FindMismatch(source.data(), copy.data(), size) == 0);
+    for (size_t position = 0; position < size; ++position) {
+      for (size_t other : {(size_t)0, position}) {
+        copy = source;
+        copy[other] ^= 1;
+        copy[position] ^= 2;
+        size_t expected = FindMismatchScalar(source.data(), copy.data(), size);
+        assert(expected == position + 1);
+        assert(FindMismatch(source.data(), copy.data(), size) == expected);
+#ifdef BIGINTEGER_AVX2_KERNELS
+        assert(!HasAvx2() || FindMismatchAvx2(source.data(), copy.data(), size) == expected);
+#endif
+      }
+    }
+  }
+}
+
+void TestFixedBigInteger() {
+  using Fixed256 = FixedBigInteger<256>;
+  static_assert((Fixed256(7) + 5) * -3 == -36);
+  static_assert(Fixed256("-1000000000000000000000") / 7 % 1000 == -142);
+
+  std::mt19937 rng(43);
+  for (int iteration = 0; iteration < 2000; ++iteration) {
+    BigInteger first(RandomDigits(rng, 1 + rng() % 38));
+    BigInteger second(RandomDigits(rng, 1 + rng() % 38));
+    if (rng() % 2) {
+      first = -first;
+    }
+    if (rng() % 3 == 0) {
+      second = -second;
+    }
+    Fixed256 fixed_first(first);
+    Fixed256 fixed_second(second);
+
+    assert(BigInteger(fixed_first) == first);
+    assert(fixed_first.toString() == first.toString());
+    assert(BigInteger(fixed_first + fixed_second) == first + second);
+    assert(BigInteger(fixed_first - fixed_second) == first - second);
+    assert(BigInteger(fixed_first * fixed_second) == first * second);
+    assert((fixed_first < fixed_second) == (first < second));
+    if (second) {
+      assert(BigInteger(fixed_first / fixed_second) == first / second);
+      assert(BigInteger(fixed_first % fixed_second) == first % second);
+    }
+  }
+
+  FixedBigInteger<100> largest(BigInteger("1267650600228229401496703205375"));
+  assert(-largest + largest == 0 && largest / largest == 1 && largest % largest == 0);
+  bool thrown = false;
+  try {
+    ++largest;
+  } catch (std::overflow_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  thrown = false;
+  try {
+    FixedBigInteger<64> too_large(BigInteger("18446744073709551616"));
+  } catch (std::overflow_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// Checks the limbs the build actually stores, as Serialize writes them, and
+// reads limbs of both radices back, which goes through ConvertRadix in one
+// direction or the other. Powers of two around multiples of kBaseBits are
+// where the two radices disagree most.
+void TestLimbRadix() {
+#ifdef BIGINTEGER_BINARY_RADIX
+  assert(kBase == 1 << kBaseBits);
+#else
+  assert(kBase == kDecimalBase);
+#endif
+
+  std::vector<std::string> numbers;
+  for (int exponent : {89, 90, 91, 119, 120, 121, 299, 300, 301, 3000}) {
+    for (int offset : {-1, 0, 1}) {
+      numbers.push_back(PowerOfTwoDigits(exponent, offset));
+    }
+  }
+  std::mt19937 rng(61);
+  for (size_t length : {28, 100, 361, 2000, 5000}) {
+    numbers.push_back(RandomDigits(rng, length));
+  }
+
+  for (const std::string& digits : numbers) {
+    BigInteger value(digits);
+    assert(value.toString() == digits && (-value).toString() == "-" + digits);
+
+    std::string binary = EncodeLimbs(LimbsOf(digits, 1 << kBaseBits), binary_limbs_layout);
+    std::string decimal = EncodeLimbs(LimbsOf(digits, kDecimalBase), decimal_limbs_layout);
+    std::string native = kBase == kDecimalBase ? decimal : binary;
+    std::string serialized(value.SerializedSize(), '\0');
+    value.Serialize(serialized.data(), serialized.data() + serialized.size());
+    assert(serialized == native);
+
+    for (const std::string& encoded : {binary, decimal}) {
+      BigInteger result;
+      std::from_chars_result read =
+          BigInteger::Deserialize(encoded.data(), encoded.data() + encoded.size(), result);
+      assert(read.ec == std::errc{} && result == value && result.toString() == digits);
+    }
+  }
+
+  BigInteger limb_base = Pow(2, kBaseBits);
+  assert(limb_base.toString() == "1073741824" && (limb_base - 1).toString() == "1073741823");
+  assert(Pow(BigInteger(kDecimalBase), 3) == BigInteger("1" + std::string(27, '0')));
+}
+
+void TestBinarySerialization() {
+  std::mt19937 rng(47);
+  std::vector<BigInteger> values = {0, 1, -1, 999999999, BigInteger("999999999999999999"),
+                                    BigInteger("-1000000000000000000")};
+  for (size_t length : {19, 100, 3000}) {
+    values.emplace_back(RandomDigits(rng, length));
+    values.push_back(-BigInteger(RandomDigits(rng, length)));
+  }
+
+  std::stringstream stream;
+  for (const BigInteger& value : values) {
+    std::string buffer(value.SerializedSize(), '\0');
+    std::to_chars_result written = value.Serialize(buffer.data(), buffer.data() + buffer.size());
+    assert(written.ec == std::errc{} && written.ptr == buffer.data() + buffer.size());
+
+    BigInteger result = value + 1;
+    result -= 1;
+    int allocations_before = new_called;
+    std::from_chars_result read = BigInteger::Deserialize(buffer.data(), written.ptr, result);
+    assert(new_called == allocations_before);
+    assert(read.ec == std::errc{} && read.ptr == written.ptr && result == value);
+
+    BigInteger unchanged = 7;
+    assert(BigInteger::Deserialize(buffer.data(), written.ptr - 1, unchanged).ec ==
+           std::errc::invalid_argument);
+    assert(unchanged == 7);
+    assert(value.Serialize(buffer.data(), written.ptr - 1).ec == std::errc::value_too_large);
+
+    value.WriteBinary(stream);
+  }
+
+  Rational fraction(BigInteger(RandomDigits(rng, 200)), -BigInteger(RandomDigits(rng, 150)));
+  fraction.WriteBinary(stream);
+  for (const BigInteger& value : values) {
+    BigInteger result;
+    assert(BigInteger::ReadBinary(stream, result) && result == value);
+  }
+  Rational fraction_result;
+  assert(Rational::ReadBinary(stream, fraction_result) && fraction_result == fraction);
+  BigInteger past_end = 5;
+  assert(!BigInteger::ReadBinary(stream, past_end) && past_end == 0);
+
+  // Limbs written in either radix read back the same.
+  const char binary_limbs[] = {0x12, 0x04, 5, 0, 0, 0, 1, 0, 0, 0};
+  const char decimal_limbs[] = {0x11, 0x04, 5, 0, 0, 0, 1, 0, 0, 0};
+  BigInteger result;
+  assert(BigInteger::Deserialize(binary_limbs, binary_limbs + 10, result).ec == std::errc{});
+  assert(result == BigInteger("1073741829"));
+  assert(BigInteger::Deserialize(decimal_limbs, decimal_limbs + 10, result).ec == std::errc{});
+  assert(result == BigInteger("1000000005"));
+  const char future_version[] = {0x21, 0x00};
+  assert(BigInteger::Deserialize(future_version, future_version + 2, result).ec ==
+         std::errc::invalid_argument);
+
+  // The tenth byte of a header carries bit 63 only.
+  std::string widest = "\x10" + std::string(9, '\xFF') + "\x01";
+  assert(BigInteger::Deserialize(widest.data(), widest.data() + widest.size(), result).ec ==
+             std::errc{} &&
+         result == BigInteger("-9223372036854775807"));
+  for (std::string overlong : {"\x10" + std::string(9, '\xFF') + "\x02",
+                               "\x12" + std::string(9, '\x80') + "\x81" + std::string(1, '\0')}) {
+    result = 3;
+    assert(BigInteger::Deserialize(overlong.data(), overlong.data() + overlong.size(), result).ec ==
+               std::errc::invalid_argument &&
+           result == 3);
+    std::stringstream overlong_stream(overlong);
+    assert(!BigInteger::ReadBinary(overlong_stream, result) && result == 0);
+  }
+}
+
+void TestRationalToDouble() {
+  assert((double)Rational(1, 3) == 1.0 / 3);
+  assert((double)Rational(-22, 7) == -22.0 / 7);
+  assert((double)Rational(0, 5) == 0);
+  assert((double)Rational(BigInteger("9007199254740993"), 1) == 9007199254740992.0);
+  assert((double)Rational(BigInteger("9007199254740995"), 1) == 9007199254740996.0);
+
+  BigInteger power = 1;
+  for (int i = 0; i < 1074; ++i) {
+    power *= 2;
+  }
+  assert((double)Rational(1, power) == std::ldexp(1.0, -1074));
+  assert((double)Rational(-1, power * 2) == 0 && std::signbit((double)Rational(-1, power * 2)));
+  assert((double)Rational(power * 3, power * 7 + 1) == 3.0 / 7);
+  assert((double)Rational(power * power, 3) == HUGE_VAL);
+
+  assert(Rational(-202, 4).asDecimal(3) == "-50.500");
+  assert(Rational(1, 7).asDecimal(30) == "0.142857142857142857142857142857");
+}
+
+void TestStreamInput() {
+  std::mt19937 rng(53);
+  for (size_t length = 1; length <= 40; ++length) {
+    std::string digits = RandomDigits(rng, length);
+    std::istringstream stream(" -" + digits + "\n" + digits);
+    BigInteger negative_value;
+    BigInteger positive_value;
+    stream >> negative_value >> positive_value;
+    assert(stream.eof() && negative_value == -BigInteger(digits));
+    assert(positive_value == BigInteger(digits));
+  }
+
+  std::string digits = RandomDigits(rng, 200000);
+  std::istringstream long_stream(digits + " 0007");
+  BigInteger value;
+  BigInteger small_value;
+  assert(BigInteger::ReadDecimal(long_stream, value, digits.size()) >> small_value);
+  assert(value == BigInteger(digits) && small_value == 7);
+
+  std::istringstream mixed("123abc -x");
+  std::string rest;
+  assert(mixed >> value >> rest && value == 123 && rest == "abc");
+  std::istringstream plus(" +42");
+  assert(plus >> value && value == 42);
+  assert(!(mixed >> value));
+}
+
+void TestRootsAndPowers() {
+  BigInteger power = 1;
+  for (int i = 0; i < 300; ++i) {
+    power *= -7;
+  }
+  assert(Pow(-7, 300) == power && Pow(-7, 301) == power * -7);
+  assert(Pow(0, 0) == 1 && Pow(0, 5) == 0 && Pow(-1, 7) == -1);
+  assert(Pow(BigInteger("-1000000000000000000"), 51) ==
+         -BigInteger("1" + std::string(918, '0')));
+
+  BigInteger base("123456789");
+  int allocations_before = new_called;
+  BigInteger small_power = Pow(base, 20);
+  assert(new_called - allocations_before <= 2);
+  assert(small_power == Pow(base, 10) * Pow(base, 10) && small_power % base == 0);
+
+  std::mt19937 rng(59);
+  for (int iteration = 0; iteration < 300; ++iteration) {
+    BigInteger value(RandomDigits(rng, 1 + rng() % (iteration < 250 ? 60 : 3000)));
+    BigInteger root = ISqrt(value);
+    assert(root * root <= value && (root + 1) * (root + 1) > value);
+    assert(ISqrt(root * root) == root && ISqrt(root * root - 1) == root - 1);
+
+    unsigned long long degree = 3 + rng() % 15;
+    assert(degree % 2 == 0 || IRoot(-value, degree) == -IRoot(value, degree));
+    root = IRoot(value, degree);
+    assert(Pow(root, degree) <= value && Pow(root + 1, degree) > value);
+    assert(IRoot(Pow(root + 1, degree), degree) == root + 1);
+  }
+  assert(ISqrt(0) == 0 && ISqrt(1) == 1 && ISqrt(99) == 9 && IRoot(5, 1) == 5);
+
+  BigInteger small("123456789012345678901234567890");
+  assert(IRoot(small, 10000000000) == 1 && IRoot(-small, 10000000001) == -1);
+  for (unsigned long long bits : {3, 60, 99, 100, 101, 1000}) {
+    BigInteger two_power = Pow(2, bits);
+    assert(IRoot(two_power, bits) == 2 && IRoot(two_power - 1, bits) == 1);
+    assert(IRoot(two_power - 1, bits - 1) == 2 && IRoot(two_power, bits + 1) == 1);
+  }
+
+  bool thrown = false;
+  try {
+    IRoot(-16, 4);
+  } catch (std::domain_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void TestHashing() {
+  std::mt19937 rng(61);
+  std::unordered_set<BigInteger> integers;
+  std::unordered_set<Rational> fractions;
+  for (int i = 0; i < 200; ++i) {
+    BigInteger value(RandomDigits(rng, 1 + rng() % 100));
+    integers.insert(value);
+    integers.insert(-value);
+    fractions.insert(Rational(value, i + 1));
+  }
+
+  std::mt19937 replay(61);
+  for (int i = 0; i < 200; ++i) {
+    BigInteger value(RandomDigits(replay, 1 + replay() % 100));
+    BigInteger twice = value * 2;
+    assert(integers.count(twice / 2) == 1 && integers.count(-twice / 2) == 1);
+    assert(fractions.count(Rational(twice * 3, BigInteger(6 * (i + 1)))) == 1);
+  }
+  assert(integers.count(0) == 0 && integers.size() == 400);
+
+  BigInteger value("123456789012345678901234567890");
+  size_t hash = value.Hash();
+  value += 1;
+  assert(value.Hash() == BigInteger("123456789012345678901234567891").Hash());
+  value -= 1;
+  assert(value.Hash() == hash);
+  value = -std::move(value);
+  assert(value.Hash() == BigInteger("-123456789012345678901234567890").Hash() && value.Hash() != hash);
+
+  Rational fraction(1, 3);
+  hash = fraction.Hash();
+  fraction *= 3;
+  assert(fraction.Hash() == Rational(1).Hash() && fraction.Hash() != hash);
+  assert((-fraction).Hash() == Rational(-2, 2).Hash());
+
+  // With BIGINTEGER_CACHE_HASH the first Hash() of a shared value fills its
+  // cache from whichever thread gets there.
+  const BigInteger shared_value(RandomDigits(rng, 500));
+  const Rational shared_fraction(shared_value, shared_value + 1);
+  size_t hashes[2][2];
+  std::thread other([&] {
+    hashes[1][0] = shared_value.Hash();
+    hashes[1][1] = shared_fraction.Hash();
+  });
+  hashes[0][0] = shared_value.Hash();
+  hashes[0][1] = shared_fraction.Hash();
+  other.join();
+  assert(hashes[0][0] == hashes[1][0] && hashes[0][1] == hashes[1][1]);
+  assert(shared_value.Hash() == BigInteger(shared_value).Hash());
+}
+
+void TestFusedExpressions() {
+  std::mt19937 rng(67);
+  auto random_signed = [&rng](size_t max_length) {
+    BigInteger value(RandomDigits(rng, 1 + rng() % max_length));
+    return rng() % 2 ? -value : value;
+  };
+  auto multiply = [](BigInteger first, const BigInteger& second) {
+    first *= second;
+    return first;
+  };
+
+  for (int iteration = 0; iteration < 300; ++iteration) {
+    size_t max_length = iteration < 250 ? 200 : 1000;
+    BigInteger a = random_signed(max_length), b = random_signed(max_length);
+    BigInteger c = random_signed(max_length), d = random_signed(max_length);
+    BigInteger e = random_signed(max_length);
+
+    BigInteger sum = BigIntegerProduct(a, b) + BigIntegerProduct(c, d);
+    assert(sum == multiply(a, b) + multiply(c, d));
+    BigInteger difference = BigIntegerProduct(a, b) - BigIntegerProduct(c, d) - e;
+    assert(difference == multiply(a, b) - multiply(c, d) - e);
+    BigInteger zero = BigIntegerProduct(a, b) - BigIntegerProduct(b, a);
+    assert(zero == 0 && !(zero < 0));
+
+    BigInteger expected = multiply(a, b) + multiply(a, a) - c;
+    (BigIntegerProduct(a, b) + BigIntegerProduct(a, a) - c).EvaluateInto(a);
+    assert(a == expected);
+  }
+
+  BigInteger first(RandomDigits(rng, 180));
+  BigInteger second(RandomDigits(rng, 180));
+  int allocations_before = new_called;
+  BigInteger fused = BigIntegerProduct(first, second) - BigIntegerProduct(second, second);
+  assert(new_called - allocations_before == 1);
+  (BigIntegerProduct(second, first) + BigIntegerProduct(first, first)).EvaluateInto(fused);
+  assert(new_called - allocations_before == 1);
+  assert(fused == multiply(first, second) + multiply(first, first));
+}
+
+void TestArena() {
+  Rational expected;
+  for (int i = 1; i <= 300; ++i) {
+    expected += Rational(1, i);
+  }
+
+  Rational harmonic;
+  BigInteger product;
+  std::mt19937 rng(71);
+  BigInteger first(RandomDigits(rng, 400000));
+  BigInteger second(RandomDigits(rng, 200000));
+  int allocations_before = new_called;
+  {
+    BigIntegerArena arena;
+    Rational sum;
+    for (int i = 1; i <= 300; ++i) {
+      sum += Rational(1, i);
+    }
+    harmonic = arena.Export(sum);
+    assert(new_called - allocations_before < 30);
+
+    BigInteger small = BigInteger(RandomDigits(rng, 2000));
+    size_t reserved = arena.ReservedBytes();
+    for (int i = 0; i < 1000; ++i) {
+      BigInteger square = small * small + small;
+      assert(square > small && (square - small) % small == 0);
+      if (i == 0) {
+        reserved = arena.ReservedBytes();
+      }
+    }
+    assert(arena.ReservedBytes() == reserved);
+    assert(BigInteger(first.toString()) == first);
+
+    SetThreadCount(4);
+    BigInteger local_product = first * second;
+    product = arena.Export(local_product);
+    SetThreadCount(1);
+  }
+  assert(harmonic == expected);
+  assert(product == first * second);
+
+  BigInteger factorial;
+  {
+    BigIntegerArena arena;
+    SetThreadCount(4);
+    BigInteger local_factorial = Factorial(6000, true);
+    SetThreadCount(1);
+    factorial = arena.Export(local_factorial);
+  }
+  assert(factorial == Factorial(6000));
+
+  BigInteger declared_outside = 1;
+  {
+    BigIntegerArena arena;
+    BigInteger grown = declared_outside;
+    for (int i = 0; i < 50; ++i) {
+      grown *= 1000000007;
+    }
+    declared_outside = arena.Export(grown);
+  }
+  assert(declared_outside == Pow(BigInteger(1000000007), 50));
+}
+
+void TestSmallRationals() {
+  auto expected = [](BigInteger num, BigInteger denom) {
+    if (denom < 0) {
+      num = -num;
+      denom = -denom;
+    }
+    if (num == 0) {
+      return std::string("0");
+    }
+    BigInteger gcd = Gcd(num < 0 ? -num : num, denom);
+    num /= gcd;
+    denom /= gcd;
+    return denom == 1 ? num.toString() : num.toString() + "/" + denom.toString();
+  };
+
+  std::mt19937 rng(71);
+  const long long kEdges[] = {1, 2, 3, 6, 1LL << 31, (1LL << 62) - 1, 1LL << 62,
+                              INT64_MAX - 1, INT64_MAX};
+  auto random_part = [&rng, &kEdges](bool positive) {
+    unsigned long long bits = (unsigned long long)rng() << 32 | rng();
+    long long value = rng() % 3 == 0 ? kEdges[rng() % std::size(kEdges)]
+                                     : (long long)(bits >> (1 + rng() % 63));
+    value = std::max(value, 1LL);
+    return BigInteger(std::to_string(positive || rng() % 2 ? value : -value));
+  };
+
+  for (int i = 0; i < 4000; ++i) {
+    BigInteger a = random_part(false), b = random_part(true);
+    BigInteger c = random_part(false), d = random_part(true);
+    if (i % 10 == 0) {
+      c *= BigInteger(RandomDigits(rng, 30));
+    }
+    Rational first(a, b), second(c, d);
+
+    Rational sum = first;
+    sum += second;
+    assert(sum.toString() == expected(a * d + c * b, b * d));
+    Rational difference = first;
+    difference -= second;
+    assert(difference.toString() == expected(a * d - c * b, b * d));
+    Rational product = first;
+    product *= second;
+    assert(product.toString() == expected(a * c, b * d));
+    Rational quotient = first;
+    quotient /= second;
+    assert(quotient.toString() == expected(a * d, b * c));
+
+    assert((first < second) == (a * d < c * b));
+    assert((first == second) == (a * d == c * b));
+    assert(difference + second == first);
+  }
+
+  Rational total = 0;
+  for (int i = 1; i <= 60; ++i) {
+    total += Rational(1, i);
+  }
+  for (int i = 60; i >= 1; --i) {
+    total -= Rational(1, i);
+  }
+  assert(total == 0 && total.toString() == "0");
+
+  const BigInteger kMax(std::to_string(INT64_MAX));
+  Rational overflow = kMax;
+  overflow *= overflow;
+  overflow /= kMax;
+  assert(overflow == kMax);
+  assert(Rational(-kMax - 1, 3) < Rational(kMax, -3));
+}
+
+void TestLiterals() {
+  using Fixed256 = FixedBigInteger<256>;
+  static_assert(123456789012345678901234567890_fbi % 1000000007 == 197434842);
+  constexpr Fixed256 kPrime(
+      57896044618658097711785492504343953926634992332820282019728792003956564819949_fbi);
+  static_assert(kPrime % 1'000'000'007_fbi == 396422614);
+  static_assert(0_fbi == 0 && 1'000_fbi == 1000);
+
+  constexpr auto kPowers = [] {
+    std::array<Fixed256, 8> powers{1};
+    for (size_t i = 1; i < powers.size(); ++i) {
+      powers[i] = powers[i - 1] * 1'000'000'000_fbi;
+    }
+    return powers;
+  }();
+  assert(BigInteger(kPowers[7]) == BigInteger("1" + std::string(63, '0')));
+
+  BigInteger prime = 57896044618658097711785492504343953926634992332820282019728792003956564819949_bi;
+  assert(prime == BigInteger(kPrime) && prime.toString() == kPrime.toString());
+  assert(-123'456'789'012'345'678'901_bi == BigInteger("-123456789012345678901"));
+  assert(0_bi == 0 && 7_bi * 6_bi == 42 && 1000000000_bi == BigInteger("1000000000"));
+
+  static_assert(0x1F_fbi == 31 && 0XaBc_fbi == 2748 && 0b101_fbi == 5 && 0B1_fbi == 1);
+  static_assert(017_fbi == 15 && 00_fbi == 0 && 0x0_fbi == 0);
+  assert(0xFFFF'FFFF'FFFF'FFFF'FFFF_bi == Pow(2, 80) - 1);
+  assert(0b1'0000'0000'0000'0000'0000'0000'0000'0000'0000'0000'0000'0000'0000'0000'0000'0000_bi ==
+         Pow(2, 64));
+  assert(01234567012345670123456701234567_bi == BigInteger("1616895878810725189668911479"));
+}
+
+void TestContinuedFractions() {
+  std::mt19937 rng(73);
+  for (int i = 0; i < 300; ++i) {
+    BigInteger dividend(RandomDigits(rng, 1 + rng() % 80));
+    BigInteger divisor(RandomDigits(rng, 1 + rng() % 40));
+    dividend = rng() % 2 ? -dividend : dividend;
+    divisor = rng() % 2 ? -divisor : divisor;
+    BigInteger quotient = dividend;
+    BigInteger remainder = divisor;
+    DivMod(quotient, remainder, quotient, remainder);
+    assert(quotient == dividend / divisor && remainder == dividend % divisor);
+  }
+
+  auto terms = [](const std::vector<BigInteger>& values) {
+    std::string result;
+    for (const BigInteger& value : values) {
+      result += value.toString() + " ";
+    }
+    return result;
+  };
+  assert(terms(Rational(415, 93).ContinuedFraction()) == "4 2 6 7 ");
+  assert(terms(Rational(-415, 93).ContinuedFraction()) == "-5 1 1 6 7 ");
+  assert(terms(Rational(0).ContinuedFraction()) == "0 ");
+
+  for (int i = 0; i < 100; ++i) {
+    Rational value(BigInteger(RandomDigits(rng, 1 + rng() % 60)) * (rng() % 2 ? 1 : -1),
+                   BigInteger(RandomDigits(rng, 1 + rng() % 60)));
+    std::vector<BigInteger> fraction = value.ContinuedFraction();
+    Rational rebuilt = fraction.back();
+    for (size_t j = fraction.size() - 1; j-- > 0;) {
+      rebuilt = Rational(fraction[j]) + Rational(1) / rebuilt;
+    }
+    assert(rebuilt == value);
+
+    Rational::Convergents convergents(value);
+    Rational convergent;
+    size_t count = 0;
+    while (convergents.Next(convergent)) {
+      assert(convergents.Term() == fraction[count++]);
+      assert(convergent.toString() == (convergent + 0).toString());
+    }
+    assert(count == fraction.size() && convergent == value);
+  }
+
+  Rational pi(BigInteger("3141592653589793"), BigInteger("1000000000000000"));
+  assert(pi.BestApproximation(7) == Rational(22, 7));
+  assert(pi.BestApproximation(100) == Rational(311, 99));
+  assert(pi.BestApproximation(1000) == Rational(355, 113));
+  assert(pi.BestApproximation(1000000).toString() == "3126535/995207");
+  assert(pi.BestApproximation(BigInteger("1000000000000000")) == pi);
+
+  for (int i = 0; i < 200; ++i) {
+    Rational value(int(rng() % 20000) - 10000, int(rng() % 5000) + 1);
+    int max_denominator = rng() % 40 + 1;
+    Rational best = value.BestApproximation(max_denominator);
+    Rational best_error = best < value ? value - best : best - value;
+    for (int denominator = 1; denominator <= max_denominator; ++denominator) {
+      Rational scaled = value * denominator;
+      BigInteger floor = scaled.ContinuedFraction()[0];
+      for (BigInteger numerator : {floor, floor + 1}) {
+        Rational error = value - Rational(numerator, denominator);
+        assert(best_error <= (error < 0 ? -error : error));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestMultiplicationNines();
+  TestMultiplicationIdentities();
+  TestHugeMultiplication();
+  TestDivision();
+  TestLargeDivision();
+  TestDecimalConversion();
+  TestWordSizedArithmeticDoesNotAllocate();
+  TestInPlaceAddition();
+  TestGcd();
+  TestRationalNormalization();
+  TestModularArithmetic();
+  TestProductTree();
+  TestThreadedArithmetic();
+  TestLimbKernels();
+  TestFixedBigInteger();
+  TestLimbRadix();
+  TestBinarySerialization();
+  TestRationalToDouble();
+  TestStreamInput();
+  TestRootsAndPowers();
+  TestHashing();
+  TestFusedExpressions();
+  TestArena();
+  TestSmallRationals();
+  TestLiterals();
+  TestContinuedFractions();
+
+  std::cout << 0;
+}
@@ -638,6 +638,9 @@ class UnorderedMap {
       cur_node = static_cast<Node<NodeType>*>(cur_node->next);
     }
 
+    // A new key starts its bucket, so every key of the bucket is still found
+    // by walking forward from pointers_to_nodes.
+    cur_node = pointers_to_nodes[cur_hash_mod];
     nodes.insert((typename List<NodeType, Alloc>::iterator)(cur_node), NodeType(key, Value()));
     static_cast<Node<NodeType>*>(cur_node->prev)->hash = cur_hash;
     pointers_to_nodes[cur_hash_mod] = static_cast<Node<NodeType>*>(cur_node->prev);
@@ -669,6 +672,7 @@ class UnorderedMap {
       cur_node = static_cast<Node<NodeType>*>(cur_node->next);
     }
 
+    cur_node = pointers_to_nodes[cur_hash_mod];
     nodes.insert((typename List<NodeType, Alloc>::iterator)(cur_node), NodeType(std::move(key),
                                                                        Value()));
     pointers_to_nodes[cur_hash_mod] = static_cast<Node<NodeType>*>(cur_node->prev);
@@ -996,6 +1000,7 @@ class UnorderedMap {
       cur_node = static_cast<Node<NodeType>*>(cur_node->next);
     }
 
+    cur_node = pointers_to_nodes[cur_hash_mod];
     nodes.insert((typename List<NodeType, Alloc>::iterator)(cur_node), node_type);
     pointers_to_nodes[cur_hash_mod] = static_cast<Node<NodeType>*>(cur_node->prev);
     static_cast<Node<NodeType>*>(cur_node->prev)->hash = cur_hash;
@@ -1042,6 +1047,7 @@ class UnorderedMap {
       cur_node = static_cast<Node<NodeType>*>(cur_node->next);
     }
 
+    cur_node = pointers_to_nodes[cur_hash_mod];
     nodes.insert((typename List<NodeType, Alloc>::iterator)(cur_node), pointer);
     pointers_to_nodes[cur_hash_mod] = static_cast<Node<NodeType>*>(cur_node->prev);
     iterator for_return = iterator(cur_node->prev);
@@ -1,10 +1,12 @@
 #include "unordered_map.h"
 //#include <unordered_map>
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <iterator>
 #include <cassert>
+#include <tuple>
 
 #include <iostream>
 
@@ -397,19 +399,59 @@ void TestCustomAlloc() {
     }    
 }
 
+// Well-mixed hashes shared by many keys, so every bucket holds a run of
+// colliding keys and new keys keep landing in buckets that already exist.
+struct CollidingHash {
+    size_t operator()(long long key) const {
+        return (size_t)(key % 5 + 1) * 0x9E3779B97F4A7C15ull;
+    }
+};
+
+void TestCollidingKeys() {
+    UnorderedMap<long long, long long, CollidingHash> m;
+    const long long count = 1000;
+    for (long long key = 0; key < count; ++key) {
+        switch (key % 4) {
+            case 0: m.insert({key, key}); break;
+            case 1: m.emplace(key, key); break;
+            case 2: m[key] = key; break;
+            default: {
+                long long copy = key;
+                m[std::move(copy)] = key;
+            }
+        }
+    }
+    assert(m.size() == count);
+
+    std::vector<int> seen(count, 0);
+    for (const auto& [key, value] : m) {
+        assert(key == value);
+        ++seen[key];
+    }
+    assert(std::count(seen.begin(), seen.end(), 1) == count);
+
+    for (long long key = 0; key < count; ++key) {
+        auto it = m.find(key);
+        assert(it != m.end() && it->first == key && it->second == key);
+    }
+    assert(m.find(count) == m.end());
+}
+
 int main() {
     std::cerr << "Starting tests" << std::endl;
     SimpleTest();
-    std::cerr << "SimpleTest (1 of 6) passed" << std::endl;
+    std::cerr << "SimpleTest (1 of 7) passed" << std::endl;
     TestIterators();
-    std::cerr << "TestIterators (2 of 6) passed" << std::endl;
+    std::cerr << "TestIterators (2 of 7) passed" << std::endl;
     TestConstIteratorDoesntAllowModification(0);
-    std::cerr << "TestConstIteratorDoesntAllowModification (3 of 6) passed" << std::endl;
+    std::cerr << "TestConstIteratorDoesntAllowModification (3 of 7) passed" << std::endl;
     TestNoRedundantCopies();
-    std::cerr << "TestRedundantCopies (4 of 6) passed" << std::endl;
+    std::cerr << "TestRedundantCopies (4 of 7) passed" << std::endl;
     TestCustomHashAndCompare();
-    std::cerr << "TestCustomHashAndCompare (5 of 6) passed" << std::endl;
+    std::cerr << "TestCustomHashAndCompare (5 of 7) passed" << std::endl;
     TestCustomAlloc();
-    std::cerr << "TestCustomAlloc (6 of 6) passed" << std::endl;
+    std::cerr << "TestCustomAlloc (6 of 7) passed" << std::endl;
+    TestCollidingKeys();
+    std::cerr << "TestCollidingKeys (7 of 7) passed" << std::endl;
     std::cout << 0;
 }
\ No newline at end of file